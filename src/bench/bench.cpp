@@ -4,6 +4,9 @@
 
 #include "bench.h"
 
+#include <univalue.h>
+
+#include <algorithm>
 #include <iostream>
 #include <sys/time.h>
 
@@ -23,17 +26,49 @@ BenchRunner::BenchRunner(std::string name, BenchFunction func)
 }
 
 void
-BenchRunner::RunAll(double elapsedTimeForOne)
+BenchRunner::RunAll(double elapsedTimeForOne, OutputFormat format, const std::string& filter)
 {
-    std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << "\n";
+    UniValue results(UniValue::VARR);
+    if (format == OUTPUT_CSV)
+        std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "median" << "," << "max" << "," << "average" << "\n";
 
     for (std::map<std::string,BenchFunction>::iterator it = benchmarks.begin();
          it != benchmarks.end(); ++it) {
 
+        if (it->first.find(filter) == std::string::npos)
+            continue;
+
         State state(it->first, elapsedTimeForOne);
         BenchFunction& func = it->second;
         func(state);
+
+        if (format == OUTPUT_CSV) {
+            std::cout << state.GetName() << "," << state.GetCount() << "," << state.GetMin() << "," << state.GetMedian()
+                      << "," << state.GetMax() << "," << state.GetAverage() << "\n";
+        } else {
+            UniValue result(UniValue::VOBJ);
+            result.push_back(Pair("name", state.GetName()));
+            result.push_back(Pair("count", state.GetCount()));
+            result.push_back(Pair("min", state.GetMin()));
+            result.push_back(Pair("median", state.GetMedian()));
+            result.push_back(Pair("max", state.GetMax()));
+            result.push_back(Pair("average", state.GetAverage()));
+            results.push_back(result);
+        }
     }
+
+    if (format == OUTPUT_JSON)
+        std::cout << results.write(2) << "\n";
+}
+
+double State::GetMedian() const
+{
+    if (samples.empty())
+        return averageTime;
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    size_t mid = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
 }
 
 bool State::KeepRunning()
@@ -53,6 +88,7 @@ bool State::KeepRunning()
         double elapsedOne = (now - lastTime)/timeCheckCount;
         if (elapsedOne < minTime) minTime = elapsedOne;
         if (elapsedOne > maxTime) maxTime = elapsedOne;
+        samples.push_back(elapsedOne);
         if (elapsedOne*timeCheckCount < maxElapsed/16) timeCheckCount *= 2;
     }
     lastTime = now;
@@ -62,9 +98,7 @@ bool State::KeepRunning()
 
     --count;
 
-    // Output results
-    double average = (now-beginTime)/count;
-    std::cout << name << "," << count << "," << minTime << "," << maxTime << "," << average << "\n";
+    averageTime = (now-beginTime)/count;
 
     return false;
 }
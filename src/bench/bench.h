@@ -5,8 +5,10 @@
 #ifndef BITCOIN_BENCH_BENCH_H
 #define BITCOIN_BENCH_BENCH_H
 
+#include <limits>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <boost/function.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -36,6 +38,11 @@ BENCHMARK(CODE_TO_TIME);
  
 namespace benchmark {
 
+    enum OutputFormat {
+        OUTPUT_CSV,
+        OUTPUT_JSON
+    };
+
     class State {
         std::string name;
         double maxElapsed;
@@ -43,13 +50,24 @@ namespace benchmark {
         double lastTime, minTime, maxTime;
         int64_t count;
         int64_t timeCheckCount;
+        //! Seconds per iteration of every timed slice, for the median
+        std::vector<double> samples;
+        double averageTime;
     public:
         State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             timeCheckCount = 1;
+            averageTime = 0;
         }
         bool KeepRunning();
+
+        const std::string& GetName() const { return name; }
+        int64_t GetCount() const { return count; }
+        double GetMin() const { return minTime; }
+        double GetMax() const { return maxTime; }
+        double GetAverage() const { return averageTime; }
+        double GetMedian() const;
     };
 
     typedef boost::function<void(State&)> BenchFunction;
@@ -61,7 +79,9 @@ namespace benchmark {
     public:
         BenchRunner(std::string name, BenchFunction func);
 
-        static void RunAll(double elapsedTimeForOne=1.0);
+        /** Run every benchmark whose name contains filter and print one
+         *  record per benchmark (seconds per iteration) in the given format */
+        static void RunAll(double elapsedTimeForOne=1.0, OutputFormat format=OUTPUT_CSV, const std::string& filter="");
     };
 }
 
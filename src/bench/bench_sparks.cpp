@@ -4,18 +4,39 @@
 
 #include "bench.h"
 
+#include "chainparams.h"
 #include "key.h"
 #include "validation.h"
 #include "util.h"
 
+#include <iostream>
+
+static const double DEFAULT_BENCH_TIME = 1.0;
+
 int
 main(int argc, char** argv)
 {
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    ParseParameters(argc, argv);
+    SelectParams(CBaseChainParams::MAIN);
+
+    if (mapArgs.count("-?") || mapArgs.count("-h") || mapArgs.count("-help")) {
+        std::cout << "Usage: bench_sparks [options]\n"
+                  << "  -format=<fmt>     Output format, csv or json (default: csv)\n"
+                  << "  -filter=<name>    Only run benchmarks whose name contains <name>\n"
+                  << "  -time=<seconds>   Time spent on each benchmark (default: " << DEFAULT_BENCH_TIME << ")\n";
+        ECC_Stop();
+        return 0;
+    }
+
+    benchmark::OutputFormat format = GetArg("-format", "csv") == "json" ? benchmark::OUTPUT_JSON : benchmark::OUTPUT_CSV;
+    double elapsedTimeForOne = DEFAULT_BENCH_TIME;
+    if (mapArgs.count("-time"))
+        elapsedTimeForOne = atof(mapArgs["-time"].c_str());
 
-    benchmark::BenchRunner::RunAll();
+    benchmark::BenchRunner::RunAll(elapsedTimeForOne, format, GetArg("-filter", ""));
 
     ECC_Stop();
 }
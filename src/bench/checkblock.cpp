@@ -0,0 +1,86 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "version.h"
+
+// Synthetic block of typical P2PKH spends, as there is no recorded block data in the tree
+static CBlock CreateTestBlock(unsigned int nTx)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.nTime = 1513622125;
+    block.nBits = 0x1e0ffff0;
+    for (unsigned int i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        tx.vout.resize(2);
+        for (unsigned int j = 0; j < tx.vin.size(); j++) {
+            tx.vin[j].prevout = COutPoint(ArithToUint256(arith_uint256(i * 2 + j + 1)), j);
+            tx.vin[j].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+        }
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            tx.vout[j].nValue = (i + 1) * 1000 + j;
+            tx.vout[j].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, j) << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+        block.vtx.push_back(CTransaction(tx));
+    }
+    return block;
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CreateTestBlock(1000);
+    std::vector<char> data(stream.begin(), stream.end());
+
+    while (state.KeepRunning()) {
+        CDataStream ssBlock(data, SER_NETWORK, PROTOCOL_VERSION);
+        CBlock block;
+        ssBlock >> block;
+    }
+}
+
+static void SerializeBlock(benchmark::State& state)
+{
+    CBlock block = CreateTestBlock(1000);
+
+    while (state.KeepRunning()) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << block;
+    }
+}
+
+static void DeserializeTransaction(benchmark::State& state)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CreateTestBlock(1).vtx[0];
+    std::vector<char> data(stream.begin(), stream.end());
+
+    while (state.KeepRunning()) {
+        CDataStream ssTx(data, SER_NETWORK, PROTOCOL_VERSION);
+        CTransaction tx;
+        ssTx >> tx;
+    }
+}
+
+static void SerializeTransaction(benchmark::State& state)
+{
+    CTransaction tx = CreateTestBlock(1).vtx[0];
+
+    while (state.KeepRunning()) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << tx;
+    }
+}
+
+BENCHMARK(DeserializeBlock);
+BENCHMARK(SerializeBlock);
+BENCHMARK(DeserializeTransaction);
+BENCHMARK(SerializeTransaction);
@@ -0,0 +1,57 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "coins.h"
+#include "script/script.h"
+
+#include <vector>
+
+static const unsigned int COINS_CACHE_SIZE = 100000;
+
+static void FillCoinsCache(CCoinsViewCache& cache, std::vector<COutPoint>& vOutpoints)
+{
+    for (unsigned int i = 0; i < COINS_CACHE_SIZE; i++) {
+        COutPoint outpoint(ArithToUint256(arith_uint256(i + 1)), i % 4);
+        CTxOut txout(50000 + i, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i & 0xff) << OP_EQUALVERIFY << OP_CHECKSIG);
+        cache.AddCoin(outpoint, Coin(txout, 1, false), false);
+        vOutpoints.push_back(outpoint);
+    }
+}
+
+// Lookups of coins present in a large cache, as done when checking block and mempool inputs
+static void CoinsCacheAccessCoin(benchmark::State& state)
+{
+    CCoinsView viewDummy;
+    CCoinsViewCache cache(&viewDummy);
+    std::vector<COutPoint> vOutpoints;
+    FillCoinsCache(cache, vOutpoints);
+
+    size_t i = 0;
+    CAmount nTotal = 0;
+    while (state.KeepRunning()) {
+        nTotal += cache.AccessCoin(vOutpoints[i]).out.nValue;
+        i = (i + 7919) % vOutpoints.size();
+    }
+}
+
+// Lookups of coins missing from the cache, which fall through to the backing view
+static void CoinsCacheHaveCoinMiss(benchmark::State& state)
+{
+    CCoinsView viewDummy;
+    CCoinsViewCache cache(&viewDummy);
+    std::vector<COutPoint> vOutpoints;
+    FillCoinsCache(cache, vOutpoints);
+
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        cache.HaveCoin(COutPoint(ArithToUint256(arith_uint256(COINS_CACHE_SIZE + 1 + n)), 0));
+        n++;
+    }
+}
+
+BENCHMARK(CoinsCacheAccessCoin);
+BENCHMARK(CoinsCacheHaveCoinMiss);
@@ -0,0 +1,81 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "crypto/neoscrypt.h"
+#include "crypto/ripemd160.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "pow.h"
+#include "primitives/block.h"
+
+#include <vector>
+
+/* Number of bytes to hash per iteration */
+static const uint64_t BUFFER_SIZE = 1000*1000;
+
+static void RIPEMD160(benchmark::State& state)
+{
+    uint8_t hash[CRIPEMD160::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CRIPEMD160().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+static void SHA256(benchmark::State& state)
+{
+    uint8_t hash[CSHA256::OUTPUT_SIZE];
+    std::vector<uint8_t> in(BUFFER_SIZE,0);
+    while (state.KeepRunning())
+        CSHA256().Write(begin_ptr(in), in.size()).Finalize(hash);
+}
+
+static void HashX11Header(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80,0);
+    while (state.KeepRunning())
+        in[0] = *HashX11(in.begin(), in.end()).begin();
+}
+
+static void NeoScrypt(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80,0);
+    uint8_t hash[32];
+    while (state.KeepRunning()) {
+        neoscrypt(begin_ptr(in), hash, 0);
+        in[0] = hash[0];
+    }
+}
+
+// Hashes as many headers as the widest available engine takes at once
+static void NeoScryptLanes(benchmark::State& state)
+{
+    unsigned int nLanes = neoscrypt_lanes_width();
+    std::vector<uint8_t> in(80 * nLanes,0);
+    std::vector<uint8_t> hash(32 * nLanes);
+    while (state.KeepRunning()) {
+        neoscrypt_lanes(begin_ptr(in), begin_ptr(hash), nLanes);
+        in[0] = hash[0];
+    }
+}
+
+// Full header proof-of-work check, with the header hash cache defeated
+static void CheckProofOfWorkHeader(benchmark::State& state)
+{
+    const CChainParams& chainparams = Params(CBaseChainParams::MAIN);
+    CBlockHeader header = chainparams.GenesisBlock().GetBlockHeader();
+    while (state.KeepRunning()) {
+        header.ClearCachedHash();
+        CheckProofOfWork(header.GetHash(), header.nBits, chainparams.GetConsensus());
+    }
+}
+
+BENCHMARK(RIPEMD160);
+BENCHMARK(SHA256);
+BENCHMARK(HashX11Header);
+BENCHMARK(NeoScrypt);
+BENCHMARK(NeoScryptLanes);
+BENCHMARK(CheckProofOfWorkHeader);
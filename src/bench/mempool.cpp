@@ -0,0 +1,43 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "script/script.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static const unsigned int MEMPOOL_BATCH_SIZE = 1000;
+
+// Adds a batch of independent transactions to an empty pool per iteration;
+// clearing the pool again is part of the measured time
+static void MempoolAddUnchecked(benchmark::State& state)
+{
+    std::vector<CTransaction> vTx;
+    for (unsigned int i = 0; i < MEMPOOL_BATCH_SIZE; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(ArithToUint256(arith_uint256(i + 1)), 0);
+        tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 0x30) << std::vector<unsigned char>(33, 0x02);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i & 0xff) << OP_EQUALVERIFY << OP_CHECKSIG;
+        vTx.push_back(CTransaction(tx));
+    }
+
+    CTxMemPool pool(CFeeRate(1000));
+    LockPoints lp;
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < vTx.size(); i++) {
+            const CTransaction& tx = vTx[i];
+            CTxMemPoolEntry entry(tx, 1000 + i, 0, 0.0, 1, true, 10 * COIN, false, 1, lp);
+            pool.addUnchecked(tx.GetHash(), entry);
+        }
+        pool.clear();
+    }
+}
+
+BENCHMARK(MempoolAddUnchecked);
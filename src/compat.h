@@ -78,6 +78,14 @@ typedef u_int SOCKET;
 #define MSG_NOSIGNAL 0
 #endif
 
+// Readiness notification interfaces usable instead of select(), which is limited to FD_SETSIZE sockets
+#ifndef WIN32
+#define USE_POLL
+#endif
+#if defined(__linux__)
+#define USE_EPOLL
+#endif
+
 #ifndef WIN32
 // PRIO_MAX is not defined on Solaris
 #ifndef PRIO_MAX
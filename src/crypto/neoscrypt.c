@@ -28,10 +28,19 @@
  */
 
 
+#if defined(HAVE_CONFIG_H)
+#include "sparks-config.h"
+#endif
+
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#define NEOSCRYPT_X86
+#endif
+
 #include "neoscrypt.h"
 
 
@@ -2712,6 +2721,132 @@ void neoscrypt(const uchar *password, uchar *output, uint profile) {
 
 }
 
+
+/* Vector extensions with a multi-lane SMix engine built in and usable on this CPU */
+uint neoscrypt_lanes_exts() {
+    uint exts = cpu_vec_exts(), engines = 0;
+
+#ifdef ENABLE_AVX512
+    engines |= exts & NEOSCRYPT_VEC_AVX512;
+#endif
+#ifdef ENABLE_AVX2
+    engines |= exts & NEOSCRYPT_VEC_AVX2;
+#endif
+#ifdef __SSE2__
+    engines |= exts & NEOSCRYPT_VEC_SSE2;
+#endif
+
+    return(engines);
+}
+
+/* Number of lanes of the engine for a vector extension */
+static uint neoscrypt_lanes_ext_width(uint ext) {
+    switch(ext) {
+        case(NEOSCRYPT_VEC_AVX512):
+            return(16);
+        case(NEOSCRYPT_VEC_AVX2):
+            return(8);
+        case(NEOSCRYPT_VEC_SSE2):
+            return(4);
+        default:
+            return(1);
+    }
+}
+
+/* Widest vector extension with a usable engine, 0 if none */
+static uint neoscrypt_lanes_best_ext() {
+    uint engines = neoscrypt_lanes_exts();
+
+    if(engines & NEOSCRYPT_VEC_AVX512) return(NEOSCRYPT_VEC_AVX512);
+    if(engines & NEOSCRYPT_VEC_AVX2) return(NEOSCRYPT_VEC_AVX2);
+    if(engines & NEOSCRYPT_VEC_SSE2) return(NEOSCRYPT_VEC_SSE2);
+
+    return(0);
+}
+
+/* Number of inputs neoscrypt_lanes() hashes at once on this CPU */
+uint neoscrypt_lanes_width() {
+    return(neoscrypt_lanes_ext_width(neoscrypt_lanes_best_ext()));
+}
+
+/* neoscrypt_lanes() on the widest engine available */
+void neoscrypt_lanes(const uchar *password, uchar *output, uint count) {
+    neoscrypt_lanes_ext(password, output, count, neoscrypt_lanes_best_ext());
+}
+
+/* Multi-lane NeoScrypt(128, 2, 1) with FastKDF-BLAKE2s, i.e. profile 0:
+ * the KDF steps run per lane, SMix runs on all lanes at once in a
+ * lane-interleaved X and V; inputs that do not fill a group, or all of
+ * them if the engine for ext is not usable, fall back to neoscrypt() */
+void neoscrypt_lanes_ext(const uchar *password, uchar *output, uint count, uint ext) {
+    const size_t stack_align = 0x40;
+    const uint r = 2;
+    const uint width = (neoscrypt_lanes_exts() & ext) ? neoscrypt_lanes_ext_width(ext) : 1;
+    uint Xl[32 * r];
+    uint *X, *V;
+    uchar *mem;
+    uint i, l;
+
+    if((width > 1) && (count >= width)) {
+        /* X = r * 2 * BLOCK_SIZE, V = N * r * 2 * BLOCK_SIZE, both per lane */
+        mem = (uchar *) malloc(129 * r * 2 * BLOCK_SIZE * width + stack_align);
+        if(mem) {
+            X = (uint *) (((size_t)mem & ~(stack_align - 1)) + stack_align);
+            V = &X[32 * r * width];
+
+            for(; count >= width; count -= width) {
+                for(l = 0; l < width; l++) {
+#ifdef OPT
+                    neoscrypt_fastkdf_opt(&password[80 * l], &password[80 * l], (uchar *) Xl, 0);
+#else
+                    neoscrypt_fastkdf(&password[80 * l], 80, &password[80 * l], 80, 32,
+                      (uchar *) Xl, r * 2 * BLOCK_SIZE);
+#endif
+                    for(i = 0; i < 32 * r; i++)
+                      X[i * width + l] = Xl[i];
+                }
+
+                switch(width) {
+#ifdef ENABLE_AVX512
+                    case(16):
+                        neoscrypt_smix_avx512(X, V);
+                        break;
+#endif
+#ifdef ENABLE_AVX2
+                    case(8):
+                        neoscrypt_smix_avx2(X, V);
+                        break;
+#endif
+#ifdef __SSE2__
+                    case(4):
+                        neoscrypt_smix_sse2(X, V);
+                        break;
+#endif
+                }
+
+                for(l = 0; l < width; l++) {
+                    for(i = 0; i < 32 * r; i++)
+                      Xl[i] = X[i * width + l];
+#ifdef OPT
+                    neoscrypt_fastkdf_opt(&password[80 * l], (uchar *) Xl, &output[32 * l], 1);
+#else
+                    neoscrypt_fastkdf(&password[80 * l], 80, (uchar *) Xl,
+                      r * 2 * BLOCK_SIZE, 32, &output[32 * l], 32);
+#endif
+                }
+
+                password += 80 * width;
+                output += 32 * width;
+            }
+
+            free(mem);
+        }
+    }
+
+    for(i = 0; i < count; i++)
+      neoscrypt(&password[80 * i], &output[32 * i], 0);
+}
+
 #endif /* !(ASM) */
 
 
@@ -3255,9 +3390,30 @@ void neoscrypt_fastkdf_4way(const uchar *password, const uchar *salt,
 
 #ifndef ASM
 uint cpu_vec_exts() {
+    uint exts = 0;
+
+#ifdef NEOSCRYPT_X86
+    uint eax, ebx, ecx, edx, xcr0;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return(0);
+
+    if(edx & (1 << 26))
+      exts |= NEOSCRYPT_VEC_SSE2;
+
+    /* AVX2 and AVX-512 also need OSXSAVE and the OS to preserve the wider registers */
+    if((ecx & (1 << 27)) && (ecx & (1 << 28)) && (__get_cpuid_max(0, NULL) >= 7)) {
+        __asm__ ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        /* XMM and YMM state */
+        if(((xcr0 & 0x06) == 0x06) && (ebx & (1 << 5)))
+          exts |= NEOSCRYPT_VEC_AVX2;
+        /* XMM, YMM, opmask and ZMM state */
+        if(((xcr0 & 0xE6) == 0xE6) && (ebx & (1 << 16)))
+          exts |= NEOSCRYPT_VEC_AVX512;
+    }
+#endif
 
-    /* No assembly, no extensions */
-
-    return(0);
+    return(exts);
 }
 #endif
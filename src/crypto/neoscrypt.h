@@ -32,6 +32,25 @@ void neoscrypt_fastkdf_4way(const unsigned char *password,
 
 unsigned int cpu_vec_exts(void);
 
+/* Vector extensions reported by cpu_vec_exts() */
+#define NEOSCRYPT_VEC_SSE2   0x1
+#define NEOSCRYPT_VEC_AVX2   0x2
+#define NEOSCRYPT_VEC_AVX512 0x4
+
+/* NeoScrypt with profile 0 of count consecutive 80 byte inputs into count
+ * consecutive 32 byte outputs; groups of neoscrypt_lanes_width() inputs are
+ * hashed at once on the widest SIMD unit available, the rest one by one */
+void neoscrypt_lanes(const unsigned char *password, unsigned char *output,
+  unsigned int count);
+
+/* neoscrypt_lanes() on the engine for one of the NEOSCRYPT_VEC_* extensions
+ * only, all inputs are hashed one by one if it is not in neoscrypt_lanes_exts() */
+void neoscrypt_lanes_ext(const unsigned char *password, unsigned char *output,
+  unsigned int count, unsigned int ext);
+
+unsigned int neoscrypt_lanes_width(void);
+unsigned int neoscrypt_lanes_exts(void);
+
 #if (__cplusplus)
 }
 #else
@@ -54,6 +73,11 @@ typedef unsigned char uchar;
 
 typedef uchar hash_digest[DIGEST_SIZE];
 
+/* Multi-lane SMix engines, see neoscrypt_lanes.h */
+void neoscrypt_smix_sse2(uint *X, uint *V);
+void neoscrypt_smix_avx2(uint *X, uint *V);
+void neoscrypt_smix_avx512(uint *X, uint *V);
+
 #define ROTL32(a,b) (((a) << (b)) | ((a) >> (32 - b)))
 #define ROTR32(a,b) (((a) >> (b)) | ((a) << (32 - b)))
 
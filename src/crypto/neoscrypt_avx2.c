@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2009 Colin Percival, 2011 ArtForz
+ * Copyright (c) 2012 Andrew Moon (floodyberry)
+ * Copyright (c) 2012 Samuel Neves <sneves@dei.uc.pt>
+ * Copyright (c) 2014-2016 John Doering <ghostlander@phoenixcoin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* NeoScrypt SMix engine for AVX2, 8 lanes;
+ * built with AVX2_CFLAGS, only called after cpu_vec_exts() confirmed AVX2 */
+
+#if defined(HAVE_CONFIG_H)
+#include "sparks-config.h"
+#endif
+
+#include "neoscrypt.h"
+
+#if defined(ENABLE_AVX2)
+
+#include <immintrin.h>
+
+typedef __m256i vec;
+
+#define NEOSCRYPT_LANES 8
+#define NEOSCRYPT_SMIX  neoscrypt_smix_avx2
+
+#define VADD(a, b)    _mm256_add_epi32(a, b)
+#define VXOR(a, b)    _mm256_xor_si256(a, b)
+#define VROTL(a, n)   _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - (n)))
+#define VLOAD(p)      _mm256_loadu_si256((const __m256i *) (p))
+#define VSTORE(p, v)  _mm256_storeu_si256((__m256i *) (p), v)
+
+#include "neoscrypt_lanes.h"
+
+#endif /* ENABLE_AVX2 */
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2009 Colin Percival, 2011 ArtForz
+ * Copyright (c) 2012 Andrew Moon (floodyberry)
+ * Copyright (c) 2012 Samuel Neves <sneves@dei.uc.pt>
+ * Copyright (c) 2014-2016 John Doering <ghostlander@phoenixcoin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Multi-lane NeoScrypt(128, 2, 1) SMix engine.
+ *
+ * Not a public header: it is included by neoscrypt_sse2.c, neoscrypt_avx2.c
+ * and neoscrypt_avx512.c after they define the vector type and operations:
+ *   vec              vector of NEOSCRYPT_LANES 32-bit words
+ *   VADD, VXOR       lane-wise addition and XOR
+ *   VROTL(a, n)      lane-wise rotation to the left by a constant
+ *   VLOAD, VSTORE    unaligned loads and stores
+ *   NEOSCRYPT_LANES  number of 32-bit lanes in a vec
+ *   NEOSCRYPT_SMIX   name of the function to generate
+ *
+ * Buffers are lane-interleaved: word w of lane l lives at [w * LANES + l],
+ * so every Salsa20 / ChaCha20 step works on all lanes at once. Only the data
+ * dependent integerify lookup into V is done per lane. */
+
+#define LANE_BLOCK_WORDS  16
+#define LANE_X_WORDS      64
+#define LANE_N            128
+#define LANE_ROUNDS       20
+
+#define LW(p, w) (&(p)[(w) * NEOSCRYPT_LANES])
+
+/* Salsa20/20 of 16 interleaved words */
+static inline void lanes_salsa(uint *X) {
+    vec x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+    uint rounds;
+
+    x0 = VLOAD(LW(X, 0));   x1 = VLOAD(LW(X, 1));   x2 = VLOAD(LW(X, 2));   x3 = VLOAD(LW(X, 3));
+    x4 = VLOAD(LW(X, 4));   x5 = VLOAD(LW(X, 5));   x6 = VLOAD(LW(X, 6));   x7 = VLOAD(LW(X, 7));
+    x8 = VLOAD(LW(X, 8));   x9 = VLOAD(LW(X, 9));  x10 = VLOAD(LW(X, 10)); x11 = VLOAD(LW(X, 11));
+   x12 = VLOAD(LW(X, 12)); x13 = VLOAD(LW(X, 13)); x14 = VLOAD(LW(X, 14)); x15 = VLOAD(LW(X, 15));
+
+#define quarter(a, b, c, d) \
+    b = VXOR(b, VROTL(VADD(a, d),  7)); \
+    c = VXOR(c, VROTL(VADD(b, a),  9)); \
+    d = VXOR(d, VROTL(VADD(c, b), 13)); \
+    a = VXOR(a, VROTL(VADD(d, c), 18));
+
+    for(rounds = LANE_ROUNDS; rounds; rounds -= 2) {
+        quarter( x0,  x4,  x8, x12);
+        quarter( x5,  x9, x13,  x1);
+        quarter(x10, x14,  x2,  x6);
+        quarter(x15,  x3,  x7, x11);
+        quarter( x0,  x1,  x2,  x3);
+        quarter( x5,  x6,  x7,  x4);
+        quarter(x10, x11,  x8,  x9);
+        quarter(x15, x12, x13, x14);
+    }
+
+#undef quarter
+
+    VSTORE(LW(X, 0),  VADD(VLOAD(LW(X, 0)),  x0));  VSTORE(LW(X, 1),  VADD(VLOAD(LW(X, 1)),  x1));
+    VSTORE(LW(X, 2),  VADD(VLOAD(LW(X, 2)),  x2));  VSTORE(LW(X, 3),  VADD(VLOAD(LW(X, 3)),  x3));
+    VSTORE(LW(X, 4),  VADD(VLOAD(LW(X, 4)),  x4));  VSTORE(LW(X, 5),  VADD(VLOAD(LW(X, 5)),  x5));
+    VSTORE(LW(X, 6),  VADD(VLOAD(LW(X, 6)),  x6));  VSTORE(LW(X, 7),  VADD(VLOAD(LW(X, 7)),  x7));
+    VSTORE(LW(X, 8),  VADD(VLOAD(LW(X, 8)),  x8));  VSTORE(LW(X, 9),  VADD(VLOAD(LW(X, 9)),  x9));
+    VSTORE(LW(X, 10), VADD(VLOAD(LW(X, 10)), x10)); VSTORE(LW(X, 11), VADD(VLOAD(LW(X, 11)), x11));
+    VSTORE(LW(X, 12), VADD(VLOAD(LW(X, 12)), x12)); VSTORE(LW(X, 13), VADD(VLOAD(LW(X, 13)), x13));
+    VSTORE(LW(X, 14), VADD(VLOAD(LW(X, 14)), x14)); VSTORE(LW(X, 15), VADD(VLOAD(LW(X, 15)), x15));
+}
+
+/* ChaCha20/20 of 16 interleaved words */
+static inline void lanes_chacha(uint *X) {
+    vec x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
+    uint rounds;
+
+    x0 = VLOAD(LW(X, 0));   x1 = VLOAD(LW(X, 1));   x2 = VLOAD(LW(X, 2));   x3 = VLOAD(LW(X, 3));
+    x4 = VLOAD(LW(X, 4));   x5 = VLOAD(LW(X, 5));   x6 = VLOAD(LW(X, 6));   x7 = VLOAD(LW(X, 7));
+    x8 = VLOAD(LW(X, 8));   x9 = VLOAD(LW(X, 9));  x10 = VLOAD(LW(X, 10)); x11 = VLOAD(LW(X, 11));
+   x12 = VLOAD(LW(X, 12)); x13 = VLOAD(LW(X, 13)); x14 = VLOAD(LW(X, 14)); x15 = VLOAD(LW(X, 15));
+
+#define quarter(a, b, c, d) \
+    a = VADD(a, b); d = VROTL(VXOR(d, a), 16); \
+    c = VADD(c, d); b = VROTL(VXOR(b, c), 12); \
+    a = VADD(a, b); d = VROTL(VXOR(d, a),  8); \
+    c = VADD(c, d); b = VROTL(VXOR(b, c),  7);
+
+    for(rounds = LANE_ROUNDS; rounds; rounds -= 2) {
+        quarter( x0,  x4,  x8, x12);
+        quarter( x1,  x5,  x9, x13);
+        quarter( x2,  x6, x10, x14);
+        quarter( x3,  x7, x11, x15);
+        quarter( x0,  x5, x10, x15);
+        quarter( x1,  x6, x11, x12);
+        quarter( x2,  x7,  x8, x13);
+        quarter( x3,  x4,  x9, x14);
+    }
+
+#undef quarter
+
+    VSTORE(LW(X, 0),  VADD(VLOAD(LW(X, 0)),  x0));  VSTORE(LW(X, 1),  VADD(VLOAD(LW(X, 1)),  x1));
+    VSTORE(LW(X, 2),  VADD(VLOAD(LW(X, 2)),  x2));  VSTORE(LW(X, 3),  VADD(VLOAD(LW(X, 3)),  x3));
+    VSTORE(LW(X, 4),  VADD(VLOAD(LW(X, 4)),  x4));  VSTORE(LW(X, 5),  VADD(VLOAD(LW(X, 5)),  x5));
+    VSTORE(LW(X, 6),  VADD(VLOAD(LW(X, 6)),  x6));  VSTORE(LW(X, 7),  VADD(VLOAD(LW(X, 7)),  x7));
+    VSTORE(LW(X, 8),  VADD(VLOAD(LW(X, 8)),  x8));  VSTORE(LW(X, 9),  VADD(VLOAD(LW(X, 9)),  x9));
+    VSTORE(LW(X, 10), VADD(VLOAD(LW(X, 10)), x10)); VSTORE(LW(X, 11), VADD(VLOAD(LW(X, 11)), x11));
+    VSTORE(LW(X, 12), VADD(VLOAD(LW(X, 12)), x12)); VSTORE(LW(X, 13), VADD(VLOAD(LW(X, 13)), x13));
+    VSTORE(LW(X, 14), VADD(VLOAD(LW(X, 14)), x14)); VSTORE(LW(X, 15), VADD(VLOAD(LW(X, 15)), x15));
+}
+
+/* XOR of interleaved words */
+static inline void lanes_blkxor(uint *dst, const uint *src, uint words) {
+    uint i;
+
+    for(i = 0; i < words; i++)
+      VSTORE(LW(dst, i), VXOR(VLOAD(LW(dst, i)), VLOAD(LW(src, i))));
+}
+
+/* Copy of interleaved words */
+static inline void lanes_blkcpy(uint *dst, const uint *src, uint words) {
+    uint i;
+
+    for(i = 0; i < words; i++)
+      VSTORE(LW(dst, i), VLOAD(LW(src, i)));
+}
+
+/* Swap of interleaved words */
+static inline void lanes_blkswp(uint *blkA, uint *blkB, uint words) {
+    vec t;
+    uint i;
+
+    for(i = 0; i < words; i++) {
+        t = VLOAD(LW(blkA, i));
+        VSTORE(LW(blkA, i), VLOAD(LW(blkB, i)));
+        VSTORE(LW(blkB, i), t);
+    }
+}
+
+/* Block mixer for r = 2, see neoscrypt_blkmix() */
+static inline void lanes_blkmix(uint *X, uint chacha) {
+    uint *Xa = LW(X, 0), *Xb = LW(X, 16), *Xc = LW(X, 32), *Xd = LW(X, 48);
+
+    lanes_blkxor(Xa, Xd, LANE_BLOCK_WORDS);
+    if(chacha) lanes_chacha(Xa); else lanes_salsa(Xa);
+    lanes_blkxor(Xb, Xa, LANE_BLOCK_WORDS);
+    if(chacha) lanes_chacha(Xb); else lanes_salsa(Xb);
+    lanes_blkxor(Xc, Xb, LANE_BLOCK_WORDS);
+    if(chacha) lanes_chacha(Xc); else lanes_salsa(Xc);
+    lanes_blkxor(Xd, Xc, LANE_BLOCK_WORDS);
+    if(chacha) lanes_chacha(Xd); else lanes_salsa(Xd);
+    lanes_blkswp(Xb, Xc, LANE_BLOCK_WORDS);
+}
+
+/* Sequential memory-hard mixing of X with the scratchpad V */
+static inline void lanes_smix(uint *X, uint *V, uint chacha) {
+    uint i, j, l, w;
+
+    for(i = 0; i < LANE_N; i++) {
+        lanes_blkcpy(LW(V, i * LANE_X_WORDS), X, LANE_X_WORDS);
+        lanes_blkmix(X, chacha);
+    }
+    for(i = 0; i < LANE_N; i++) {
+        /* integerify(X) mod N differs per lane */
+        for(l = 0; l < NEOSCRYPT_LANES; l++) {
+            j = LANE_X_WORDS * (LW(X, 48)[l] & (LANE_N - 1));
+            for(w = 0; w < LANE_X_WORDS; w++)
+              LW(X, w)[l] ^= LW(V, j + w)[l];
+        }
+        lanes_blkmix(X, chacha);
+    }
+}
+
+/* NeoScrypt SMix core: ChaCha20 over a copy of X, Salsa20 over X, XOR both.
+ * X holds LANE_X_WORDS interleaved words, V must hold LANE_N * LANE_X_WORDS */
+void NEOSCRYPT_SMIX(uint *X, uint *V) {
+    uint Z[LANE_X_WORDS * NEOSCRYPT_LANES];
+
+    lanes_blkcpy(Z, X, LANE_X_WORDS);
+    lanes_smix(Z, V, 1);
+    lanes_smix(X, V, 0);
+    lanes_blkxor(X, Z, LANE_X_WORDS);
+}
+
+#undef LW
+#undef LANE_BLOCK_WORDS
+#undef LANE_X_WORDS
+#undef LANE_N
+#undef LANE_ROUNDS
@@ -8,6 +8,7 @@
 #include "chainparams.h"
 #include "clientversion.h"
 #include "hash.h"
+#include "random.h"
 #include "streams.h"
 #include "util.h"
 
@@ -18,6 +19,28 @@
 *   ---------------------------
 */
 
+/** Reads the data part of a flat database file while hashing it */
+class CFlatDBReader : public CHashVerifier<CBufferedFile>
+{
+private:
+    CBufferedFile* file;
+    uint64_t nDataSize;
+
+public:
+    CFlatDBReader(CBufferedFile* fileIn, uint64_t nDataSizeIn) : CHashVerifier<CBufferedFile>(fileIn), file(fileIn), nDataSize(nDataSizeIn) {}
+
+    // number of data bytes left to read, like CDataStream::size()
+    size_t size() { return nDataSize - file->GetPos(); }
+
+    template<typename T>
+    CFlatDBReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 template<typename T>
 class CFlatDB
 {
@@ -33,6 +56,9 @@ private:
         IncorrectFormat
     };
 
+    // must be larger than any single item read at once, e.g. a serialized string
+    static const uint64_t READ_BUFFER_SIZE = 1 << 20;
+
     boost::filesystem::path pathDB;
     std::string strFilename;
     std::string strMagicMessage;
@@ -51,11 +77,23 @@ private:
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
-        // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        // nothing changed since the last write, keep the file as is
+        uint256 hashOld;
+        if (ReadHash(hashOld) && hashOld == hash) {
+            LogPrintf("Skipped writing to %s, no changes  %dms\n", strFilename, GetTimeMillis() - nStart);
+            return true;
+        }
+
+        // Generate random temporary filename
+        unsigned short randv = 0;
+        GetRandBytes((unsigned char*)&randv, sizeof(randv));
+        boost::filesystem::path pathTmp = GetDataDir() / strprintf("%s.%04x", strFilename, randv);
+
+        // open temp output file, and associate with CAutoFile
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
         // Write and commit header, data
         try {
@@ -64,20 +102,41 @@ private:
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        // replace existing file, if any, with the new one, a crash leaves either the old or the new file intact
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
-    ReadResult Read(T& objToLoad, bool fDryRun = false)
+    /// Read the checksum stored at the end of the file
+    bool ReadHash(uint256& hashRet)
     {
-        //LOCK(objToLoad.cs);
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return false;
 
-        int64_t nStart = GetTimeMillis();
-        // open input file, and associate with CAutoFile
+        try {
+            if (fseek(filein.Get(), -(long)sizeof(uint256), SEEK_END) != 0)
+                return false;
+            filein >> hashRet;
+        }
+        catch (std::exception &e) {
+            return false;
+        }
+        return true;
+    }
+
+    /// Check only the magic message and the network magic number, not the whole file
+    ReadResult ReadHeader()
+    {
         FILE *file = fopen(pathDB.string().c_str(), "rb");
         CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
         if (filein.IsNull())
@@ -86,43 +145,60 @@ private:
             return FileError;
         }
 
-        // use file size to size memory buffer
-        int fileSize = boost::filesystem::file_size(pathDB);
-        int dataSize = fileSize - sizeof(uint256);
-        // Don't try to resize to a negative number if file is small
-        if (dataSize < 0)
-            dataSize = 0;
-        std::vector<unsigned char> vchData;
-        vchData.resize(dataSize);
-        uint256 hashIn;
-
-        // read data and checksum from file
+        unsigned char pchMsgTmp[4];
+        std::string strMagicMessageTmp;
         try {
-            filein.read((char *)&vchData[0], dataSize);
-            filein >> hashIn;
+            filein >> strMagicMessageTmp;
+            if (strMagicMessage != strMagicMessageTmp)
+            {
+                error("%s: Invalid magic message", __func__);
+                return IncorrectMagicMessage;
+            }
+
+            filein >> FLATDATA(pchMsgTmp);
+            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            {
+                error("%s: Invalid network magic number", __func__);
+                return IncorrectMagicNumber;
+            }
         }
         catch (std::exception &e) {
             error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return HashReadError;
+            return IncorrectFormat;
         }
-        filein.fclose();
 
-        CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
+        return Ok;
+    }
 
-        // verify stored checksum matches input data
-        uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-        if (hashIn != hashTmp)
+    ReadResult Read(T& objToLoad)
+    {
+        //LOCK(objToLoad.cs);
+
+        int64_t nStart = GetTimeMillis();
+        // open input file
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        if (file == NULL)
         {
-            error("%s: Checksum mismatch, data corrupted", __func__);
-            return IncorrectHash;
+            error("%s: Failed to open file %s", __func__, pathDB.string());
+            return FileError;
         }
 
+        // use file size to find where the data ends and the checksum starts
+        uint64_t fileSize = boost::filesystem::file_size(pathDB);
+        uint64_t dataSize = fileSize < sizeof(uint256) ? 0 : fileSize - sizeof(uint256);
+
+        // deserialize straight from the file and hash the data while reading it,
+        // the whole file is never held in memory
+        CBufferedFile filein(file, READ_BUFFER_SIZE, 0, SER_DISK, CLIENT_VERSION);
+        filein.SetLimit(dataSize);
+        CFlatDBReader verifier(&filein, dataSize);
 
+        ReadResult result = Ok;
         unsigned char pchMsgTmp[4];
         std::string strMagicMessageTmp;
         try {
             // de-serialize file header (file specific magic message) and ..
-            ssObj >> strMagicMessageTmp;
+            verifier >> strMagicMessageTmp;
 
             // ... verify the message matches predefined one
             if (strMagicMessage != strMagicMessageTmp)
@@ -133,7 +209,7 @@ private:
 
 
             // de-serialize file header (network specific magic number) and ..
-            ssObj >> FLATDATA(pchMsgTmp);
+            verifier >> FLATDATA(pchMsgTmp);
 
             // ... verify the network matches ours
             if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
@@ -143,21 +219,44 @@ private:
             }
 
             // de-serialize data into T object
-            ssObj >> objToLoad;
+            verifier >> objToLoad;
         }
         catch (std::exception &e) {
             objToLoad.Clear();
             error("%s: Deserialize or I/O error - %s", __func__, e.what());
-            return IncorrectFormat;
+            result = IncorrectFormat;
         }
 
+        // hash the data which wasn't deserialized (if any) and read the checksum
+        uint256 hashIn;
+        try {
+            verifier.ignore(dataSize - filein.GetPos());
+            filein.SetLimit();
+            filein >> hashIn;
+        }
+        catch (std::exception &e) {
+            objToLoad.Clear();
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+        filein.fclose();
+
+        // verify stored checksum matches input data
+        if (hashIn != verifier.GetHash())
+        {
+            objToLoad.Clear();
+            error("%s: Checksum mismatch, data corrupted", __func__);
+            return IncorrectHash;
+        }
+
+        if (result != Ok)
+            return result;
+
         LogPrintf("Loaded info from %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToLoad.ToString());
-        if(!fDryRun) {
-            LogPrintf("%s: Cleaning....\n", __func__);
-            objToLoad.CheckAndRemove();
-            LogPrintf("     %s\n", objToLoad.ToString());
-        }
+        LogPrintf("%s: Cleaning....\n", __func__);
+        objToLoad.CheckAndRemove();
+        LogPrintf("     %s\n", objToLoad.ToString());
 
         return Ok;
     }
@@ -198,8 +297,7 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        ReadResult readResult = ReadHeader();
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
@@ -211,6 +211,32 @@ void CGovernanceObject::ClearMasternodeVotes()
     }
 }
 
+static bool CompareVotesByTime(const CGovernanceVote& a, const CGovernanceVote& b)
+{
+    return a.GetTimestamp() < b.GetTimestamp();
+}
+
+bool CGovernanceObject::ReconcileVotes()
+{
+    std::vector<CGovernanceVote> vecVotes;
+    if(!fileVotes.LoadVotes(GetHash(), vecVotes)) {
+        return false;
+    }
+
+    // votes which were stored after governance.dat was written are missing
+    // from the records, apply them in the order they were created in
+    std::sort(vecVotes.begin(), vecVotes.end(), CompareVotesByTime);
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        const CGovernanceVote& vote = vecVotes[i];
+        vote_instance_t& voteInstance = mapCurrentMNVotes[vote.GetMasternodeOutpoint()].mapInstances[int(vote.GetSignal())];
+        if(vote.GetTimestamp() < voteInstance.nCreationTime) continue;
+        voteInstance = vote_instance_t(vote.GetOutcome(), voteInstance.nTime, vote.GetTimestamp());
+        mnodeman.AddGovernanceVote(vote.GetMasternodeOutpoint(), vote.GetParentHash());
+    }
+    fDirtyCache = true;
+    return true;
+}
+
 std::string CGovernanceObject::GetSignatureMessage() const
 {
     LOCK(cs);
@@ -727,6 +753,20 @@ void CGovernanceObject::CheckOrphanVotes(CConnman& connman)
 {
     int64_t nNow = GetAdjustedTime();
     const vote_mcache_t::list_t& listVotes = mapOrphanVotes.GetItemList();
+
+    // Check all signatures we can check at once, in parallel. This leaves the valid ones
+    // cached, so ProcessVote below doesn't have to do the expensive work one by one.
+    std::vector<CHashSignature> vecSignatures;
+    for(vote_mcache_t::list_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+        CHashSignature sig;
+        if(it->value.second >= nNow && it->value.first.GetSignatureCheck(sig)) {
+            vecSignatures.push_back(sig);
+        }
+    }
+    if(vecSignatures.size() > 1) {
+        CHashSigner::VerifyHashes(vecSignatures);
+    }
+
     vote_mcache_t::list_cit it = listVotes.begin();
     while(it != listVotes.end()) {
         bool fRemove = false;
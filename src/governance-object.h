@@ -294,6 +294,8 @@ public:
     int GetAbstainCount(vote_signal_enum_t eVoteSignalIn) const;
 
     bool GetCurrentMNVotes(const COutPoint& mnCollateralOutpoint, vote_rec_t& voteRecord);
+    // caller must hold governance.cs
+    const vote_m_t& GetCurrentMNVotes() const { return mapCurrentMNVotes; }
 
     // FUNCTIONS FOR DEALING WITH DATA STRING
 
@@ -349,6 +351,9 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+    /// Bring the vote records in line with the votes in the vote database
+    bool ReconcileVotes();
+
     void CheckOrphanVotes(CConnman& connman);
 
 };
@@ -13,6 +13,7 @@
 using namespace std;
 
 class CGovernanceVote;
+struct CHashSignature;
 class CConnman;
 
 // INTENTION OF MASTERNODES REGARDING ITEM
@@ -101,6 +102,8 @@ private:
     int64_t nTime;
     std::vector<unsigned char> vchSig;
 
+    std::string GetSignatureMessage() const;
+
 public:
     CGovernanceVote();
     CGovernanceVote(COutPoint outpointMasternodeIn, uint256 nParentHashIn, vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn);
@@ -123,6 +126,8 @@ public:
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(bool fSignatureCheck) const;
+    /// Signature to check for this vote (for CHashSigner::VerifyHashes), false if the masternode is unknown
+    bool GetSignatureCheck(CHashSignature& sigRet) const;
     void Relay(CConnman& connman) const;
 
     std::string GetVoteString() const {
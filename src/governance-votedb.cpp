@@ -3,15 +3,132 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-votedb.h"
+#include "util.h"
+
+#include <boost/scoped_ptr.hpp>
+
+static const char DB_OBJECT_VOTE = 'v';
+static const char DB_VOTE_PARENT = 'p';
+static const char DB_MASTERNODE_VOTE = 'm';
+static const char DB_CLEAN_SHUTDOWN = 'S';
+
+CGovernanceVoteDB* pgovernancevotedb = NULL;
+
+CGovernanceVoteDB::CGovernanceVoteDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "governance" / "votes", nCacheSize, fMemory, fWipe) {
+}
+
+bool CGovernanceVoteDB::WriteVote(const CGovernanceVote& vote) {
+    CDBBatch batch(*this);
+    uint256 nHash = vote.GetHash();
+    batch.Write(std::make_pair(DB_OBJECT_VOTE, std::make_pair(vote.GetParentHash(), nHash)), vote);
+    batch.Write(std::make_pair(DB_VOTE_PARENT, nHash), vote.GetParentHash());
+    batch.Write(std::make_pair(DB_MASTERNODE_VOTE, std::make_pair(vote.GetParentHash(), std::make_pair(vote.GetMasternodeOutpoint(), nHash))), '1');
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::HaveVote(const uint256& nParentHash, const uint256& nHash) {
+    return Exists(std::make_pair(DB_OBJECT_VOTE, std::make_pair(nParentHash, nHash)));
+}
+
+bool CGovernanceVoteDB::ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& voteRet) {
+    return Read(std::make_pair(DB_OBJECT_VOTE, std::make_pair(nParentHash, nHash)), voteRet);
+}
+
+bool CGovernanceVoteDB::ReadVoteParent(const uint256& nHash, uint256& nParentHashRet) {
+    return Read(std::make_pair(DB_VOTE_PARENT, nHash), nParentHashRet);
+}
+
+bool CGovernanceVoteDB::ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotesRet) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_OBJECT_VOTE, std::make_pair(nParentHash, uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (pcursor->GetKey(key) && key.first == DB_OBJECT_VOTE && key.second.first == nParentHash) {
+            CGovernanceVote vote;
+            if (!pcursor->GetValue(vote))
+                return error("%s: failed to read vote %s", __func__, key.second.second.ToString());
+            vecVotesRet.push_back(vote);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CGovernanceVoteDB::ReadMasternodeVotes(const uint256& nParentHash, const COutPoint& outpointMasternode, std::vector<CGovernanceVote>& vecVotesRet) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_MASTERNODE_VOTE, std::make_pair(nParentHash, std::make_pair(outpointMasternode, uint256()))));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, std::pair<COutPoint, uint256> > > key;
+        if (pcursor->GetKey(key) && key.first == DB_MASTERNODE_VOTE && key.second.first == nParentHash && key.second.second.first == outpointMasternode) {
+            CGovernanceVote vote;
+            if (!ReadVote(nParentHash, key.second.second.second, vote))
+                return error("%s: failed to read vote %s", __func__, key.second.second.second.ToString());
+            vecVotesRet.push_back(vote);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CGovernanceVoteDB::EraseVotes(const std::vector<CGovernanceVote>& vecVotes) {
+    CDBBatch batch(*this);
+    for (std::vector<CGovernanceVote>::const_iterator it = vecVotes.begin(); it != vecVotes.end(); ++it) {
+        uint256 nHash = it->GetHash();
+        batch.Erase(std::make_pair(DB_OBJECT_VOTE, std::make_pair(it->GetParentHash(), nHash)));
+        batch.Erase(std::make_pair(DB_VOTE_PARENT, nHash));
+        batch.Erase(std::make_pair(DB_MASTERNODE_VOTE, std::make_pair(it->GetParentHash(), std::make_pair(it->GetMasternodeOutpoint(), nHash))));
+    }
+    return WriteBatch(batch);
+}
+
+bool CGovernanceVoteDB::ReadParentHashes(std::set<uint256>& setParentHashesRet) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_OBJECT_VOTE, std::make_pair(uint256(), uint256())));
+
+    while (pcursor->Valid()) {
+        std::pair<char, std::pair<uint256, uint256> > key;
+        if (pcursor->GetKey(key) && key.first == DB_OBJECT_VOTE) {
+            setParentHashesRet.insert(key.second.first);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CGovernanceVoteDB::WriteCleanShutdown(bool fClean) {
+    if (fClean)
+        return Write(DB_CLEAN_SHUTDOWN, '1', true);
+    return Erase(DB_CLEAN_SHUTDOWN, true);
+}
+
+bool CGovernanceVoteDB::ReadCleanShutdown() {
+    return Exists(DB_CLEAN_SHUTDOWN);
+}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
-    : nMemoryVotes(0),
+    : nVoteCount(0),
+      nParentHash(),
       listVotes(),
       mapVoteIndex()
 {}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
-    : nMemoryVotes(other.nMemoryVotes),
+    : nVoteCount(other.nVoteCount),
+      nParentHash(other.nParentHash),
       listVotes(other.listVotes),
       mapVoteIndex()
 {
@@ -20,31 +137,52 @@ CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVote
 
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
-    listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
-    ++nMemoryVotes;
+    nParentHash = vote.GetParentHash();
+    if(pgovernancevotedb && !pgovernancevotedb->WriteVote(vote)) {
+        LogPrintf("CGovernanceObjectVoteFile::AddVote -- failed to write vote %s\n", vote.GetHash().ToString());
+    }
+    AddMemoryVote(vote);
+    ++nVoteCount;
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 {
     vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
-        return false;
+    if(it != mapVoteIndex.end()) {
+        return true;
     }
-    return true;
+    return pgovernancevotedb && nVoteCount > 0 && pgovernancevotedb->HaveVote(nParentHash, nHash);
 }
 
-bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote) const
+bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& vote)
 {
-    vote_m_cit it = mapVoteIndex.find(nHash);
-    if(it == mapVoteIndex.end()) {
+    vote_m_it it = mapVoteIndex.find(nHash);
+    if(it != mapVoteIndex.end()) {
+        vote = *(it->second);
+        // move it to the front, it's the most recently used one now
+        listVotes.splice(listVotes.begin(), listVotes, it->second);
+        return true;
+    }
+    if(!pgovernancevotedb || nVoteCount == 0 || !pgovernancevotedb->ReadVote(nParentHash, nHash, vote)) {
         return false;
     }
-    vote = *(it->second);
+    AddMemoryVote(vote);
     return true;
 }
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
+{
+    std::vector<CGovernanceVote> vecResult;
+    if(pgovernancevotedb) {
+        if(nVoteCount > 0 && !pgovernancevotedb->ReadVotes(nParentHash, vecResult)) {
+            LogPrintf("CGovernanceObjectVoteFile::GetVotes -- failed to read votes for %s\n", nParentHash.ToString());
+        }
+        return vecResult;
+    }
+    return GetMemoryVotes();
+}
+
+std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetMemoryVotes() const
 {
     std::vector<CGovernanceVote> vecResult;
     for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
@@ -58,35 +196,95 @@ void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpo
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         if(it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
             mapVoteIndex.erase(it->GetHash());
             listVotes.erase(it++);
+            if(!pgovernancevotedb) {
+                --nVoteCount;
+            }
         }
         else {
             ++it;
         }
     }
+
+    if(!pgovernancevotedb || nVoteCount == 0) return;
+
+    // only read the votes of this masternode, not all votes of the object
+    std::vector<CGovernanceVote> vecVotesToErase;
+    if(!pgovernancevotedb->ReadMasternodeVotes(nParentHash, outpointMasternode, vecVotesToErase)) {
+        LogPrintf("CGovernanceObjectVoteFile::RemoveVotesFromMasternode -- failed to read votes for %s\n", nParentHash.ToString());
+        return;
+    }
+    if(vecVotesToErase.empty()) return;
+    if(!pgovernancevotedb->EraseVotes(vecVotesToErase)) {
+        LogPrintf("CGovernanceObjectVoteFile::RemoveVotesFromMasternode -- failed to erase votes for %s\n", nParentHash.ToString());
+    }
+    nVoteCount -= vecVotesToErase.size();
+}
+
+bool CGovernanceObjectVoteFile::LoadVotes(const uint256& nParentHashIn, std::vector<CGovernanceVote>& vecVotesRet)
+{
+    if(!pgovernancevotedb) return false;
+
+    nParentHash = nParentHashIn;
+    listVotes.clear();
+    mapVoteIndex.clear();
+    vecVotesRet.clear();
+    if(!pgovernancevotedb->ReadVotes(nParentHash, vecVotesRet)) {
+        return false;
+    }
+    nVoteCount = vecVotesRet.size();
+    return true;
+}
+
+void CGovernanceObjectVoteFile::RemoveAllVotes()
+{
+    if(pgovernancevotedb && nVoteCount > 0) {
+        if(!pgovernancevotedb->EraseVotes(GetVotes())) {
+            LogPrintf("CGovernanceObjectVoteFile::RemoveAllVotes -- failed to erase votes for %s\n", nParentHash.ToString());
+        }
+    }
+    listVotes.clear();
+    mapVoteIndex.clear();
+    nVoteCount = 0;
 }
 
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
 {
-    nMemoryVotes = other.nMemoryVotes;
+    nVoteCount = other.nVoteCount;
+    nParentHash = other.nParentHash;
     listVotes = other.listVotes;
     RebuildIndex();
     return *this;
 }
 
+void CGovernanceObjectVoteFile::AddMemoryVote(const CGovernanceVote& vote)
+{
+    listVotes.push_front(vote);
+    mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    LimitMemoryVotes();
+}
+
+void CGovernanceObjectVoteFile::LimitMemoryVotes()
+{
+    // without a database, memory is the only place the votes are stored at
+    if(!pgovernancevotedb) return;
+
+    while((int)listVotes.size() > MAX_MEMORY_VOTES) {
+        mapVoteIndex.erase(listVotes.back().GetHash());
+        listVotes.pop_back();
+    }
+}
+
 void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
-    nMemoryVotes = 0;
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         CGovernanceVote& vote = *it;
         uint256 nHash = vote.GetHash();
         if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
             mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
             ++it;
         }
         else {
@@ -7,18 +7,51 @@
 
 #include <list>
 #include <map>
+#include <set>
 
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
 #include "uint256.h"
 
+//! Memory allocated to the governance vote database cache (MiB)
+static const int64_t nGovernanceVoteDBCache = 8;
+
+/** Access to the governance vote database (governance/votes/) */
+class CGovernanceVoteDB : public CDBWrapper
+{
+public:
+    CGovernanceVoteDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CGovernanceVoteDB(const CGovernanceVoteDB&);
+    void operator=(const CGovernanceVoteDB&);
+public:
+    bool WriteVote(const CGovernanceVote& vote);
+    bool HaveVote(const uint256& nParentHash, const uint256& nHash);
+    bool ReadVote(const uint256& nParentHash, const uint256& nHash, CGovernanceVote& voteRet);
+    /// Find the hash of the governance object the vote with this hash belongs to
+    bool ReadVoteParent(const uint256& nHash, uint256& nParentHashRet);
+    bool ReadVotes(const uint256& nParentHash, std::vector<CGovernanceVote>& vecVotesRet);
+    /// Read the votes of a single masternode for the governance object with this hash
+    bool ReadMasternodeVotes(const uint256& nParentHash, const COutPoint& outpointMasternode, std::vector<CGovernanceVote>& vecVotesRet);
+    bool EraseVotes(const std::vector<CGovernanceVote>& vecVotes);
+    /// Find the hashes of all governance objects which have votes stored
+    bool ReadParentHashes(std::set<uint256>& setParentHashesRet);
+    /// The database is only consistent with governance.dat after a clean shutdown
+    bool WriteCleanShutdown(bool fClean);
+    bool ReadCleanShutdown();
+};
+
+/** Global variable that points to the governance vote database (protected by governance.cs) */
+extern CGovernanceVoteDB* pgovernancevotedb;
+
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
+ * All votes are stored in pgovernancevotedb, only the most recently added or
+ * requested ones are held in memory.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Note: When there is no pgovernancevotedb (e.g. in unit tests) all votes are
+ * held in memory.
  */
 class CGovernanceObjectVoteFile
 {
@@ -36,10 +69,13 @@ public: // Types
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    static const int MAX_MEMORY_VOTES = 100;
+
+    int nVoteCount;
 
-    int nMemoryVotes;
+    uint256 nParentHash;
 
+    /// Most recently used votes first
     vote_l_t listVotes;
 
     vote_m_t mapVoteIndex;
@@ -55,37 +91,57 @@ public:
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the file contains a vote with this hash
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a vote, loading it into memory if it isn't there yet
      */
-    bool GetVote(const uint256& nHash, CGovernanceVote& vote) const;
+    bool GetVote(const uint256& nHash, CGovernanceVote& vote);
 
     int GetVoteCount() {
-        return nMemoryVotes;
+        return nVoteCount;
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
 
+    /**
+     * Votes currently held in memory, most recently used first
+     */
+    std::vector<CGovernanceVote> GetMemoryVotes() const;
+
     CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
 
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
 
+    /**
+     * Take the vote count from the database instead of the one loaded
+     * from governance.dat and return all votes stored for the object
+     */
+    bool LoadVotes(const uint256& nParentHashIn, std::vector<CGovernanceVote>& vecVotesRet);
+
+    /**
+     * Remove all votes, including the ones on disk
+     */
+    void RemoveAllVotes();
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
+        // votes themselves are stored in pgovernancevotedb
+        READWRITE(nVoteCount);
+        READWRITE(nParentHash);
         if(ser_action.ForRead()) {
-            RebuildIndex();
+            listVotes.clear();
+            mapVoteIndex.clear();
         }
     }
 private:
+    void AddMemoryVote(const CGovernanceVote& vote);
+    void LimitMemoryVotes();
     void RebuildIndex();
 
 };
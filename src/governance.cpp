@@ -18,7 +18,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-12";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-13";
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60*60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
 
@@ -63,8 +63,8 @@ bool CGovernanceManager::HaveVoteForHash(uint256 nHash)
 {
     LOCK(cs);
 
-    CGovernanceObject* pGovobj = NULL;
-    if(!mapVoteToObject.Get(nHash,pGovobj)) {
+    CGovernanceObject* pGovobj = FindVoteParent(nHash);
+    if(!pGovobj) {
         return false;
     }
 
@@ -84,8 +84,8 @@ bool CGovernanceManager::SerializeVoteForHash(uint256 nHash, CDataStream& ss)
 {
     LOCK(cs);
 
-    CGovernanceObject* pGovobj = NULL;
-    if(!mapVoteToObject.Get(nHash,pGovobj)) {
+    CGovernanceObject* pGovobj = FindVoteParent(nHash);
+    if(!pGovobj) {
         return false;
     }
 
@@ -514,6 +514,9 @@ void CGovernanceManager::UpdateCachesAndClean()
             LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
             mnodeman.RemoveGovernanceObject(pObj->GetHash());
 
+            // Remove votes from the database
+            pObj->GetVoteFile().RemoveAllVotes();
+
             // Remove vote references
             const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
             object_ref_cache_t::list_cit lit = listItems.begin();
@@ -591,27 +594,28 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     if(it == mapObjects.end()) return vecResult;
     CGovernanceObject& govobj = it->second;
 
-    CMasternode mn;
-    std::map<COutPoint, CMasternode> mapMasternodes;
-    if(mnCollateralOutpointFilter == COutPoint()) {
-        mapMasternodes = mnodeman.GetFullMasternodeMap();
-    } else if (mnodeman.Get(mnCollateralOutpointFilter, mn)) {
-        mapMasternodes[mnCollateralOutpointFilter] = mn;
+    // Only look at the vote records of the object itself (or the single one we were asked for)
+    // instead of probing every known masternode, records of unknown masternodes are skipped
+    const CGovernanceObject::vote_m_t& mapCurrentMNVotes = govobj.GetCurrentMNVotes();
+    CGovernanceObject::vote_m_cit itBegin = mapCurrentMNVotes.begin();
+    CGovernanceObject::vote_m_cit itEnd = mapCurrentMNVotes.end();
+    if(mnCollateralOutpointFilter != COutPoint()) {
+        itBegin = mapCurrentMNVotes.find(mnCollateralOutpointFilter);
+        if(itBegin != itEnd) itEnd = std::next(itBegin);
     }
 
     // Loop thru each MN collateral outpoint and get the votes for the `nParentHash` governance object
-    for (auto& mnpair : mapMasternodes)
+    for (CGovernanceObject::vote_m_cit it2 = itBegin; it2 != itEnd; ++it2)
     {
-        // get a vote_rec_t from the govobj
-        vote_rec_t voteRecord;
-        if (!govobj.GetCurrentMNVotes(mnpair.first, voteRecord)) continue;
+        if (!mnodeman.Has(it2->first)) continue;
 
-        for (vote_instance_m_it it3 = voteRecord.mapInstances.begin(); it3 != voteRecord.mapInstances.end(); ++it3) {
+        const vote_rec_t& voteRecord = it2->second;
+        for (vote_instance_m_cit it3 = voteRecord.mapInstances.begin(); it3 != voteRecord.mapInstances.end(); ++it3) {
             int signal = (it3->first);
             int outcome = ((it3->second).eOutcome);
             int64_t nCreationTime = ((it3->second).nCreationTime);
 
-            CGovernanceVote vote = CGovernanceVote(mnpair.first, nParentHash, (vote_signal_enum_t)signal, (vote_outcome_enum_t)outcome);
+            CGovernanceVote vote = CGovernanceVote(it2->first, nParentHash, (vote_signal_enum_t)signal, (vote_outcome_enum_t)outcome);
             vote.SetTime(nCreationTime);
 
             vecResult.push_back(vote);
@@ -697,7 +701,8 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
     break;
     case MSG_GOVERNANCE_OBJECT_VOTE:
     {
-        if(mapVoteToObject.HasKey(inv.hash)) {
+        uint256 nParentHash;
+        if(mapVoteToObject.HasKey(inv.hash) || (pgovernancevotedb && pgovernancevotedb->ReadVoteParent(inv.hash, nParentHash))) {
             LogPrint("gobject", "CGovernanceManager::ConfirmInventoryRequest already have governance vote, returning false\n");
             return false;
         }
@@ -1272,13 +1277,37 @@ void CGovernanceManager::RebuildIndexes()
     mapVoteToObject.Clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+        // votes which are only on disk are found via FindVoteParent
+        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetMemoryVotes();
         for(size_t i = 0; i < vecVotes.size(); ++i) {
             mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
         }
     }
 }
 
+CGovernanceObject* CGovernanceManager::FindVoteParent(const uint256& nHash)
+{
+    AssertLockHeld(cs);
+
+    CGovernanceObject* pGovobj = NULL;
+    if(mapVoteToObject.Get(nHash, pGovobj)) {
+        return pGovobj;
+    }
+
+    uint256 nParentHash;
+    if(!pgovernancevotedb || !pgovernancevotedb->ReadVoteParent(nHash, nParentHash)) {
+        return NULL;
+    }
+
+    object_m_it it = mapObjects.find(nParentHash);
+    if(it == mapObjects.end()) {
+        return NULL;
+    }
+
+    mapVoteToObject.Insert(nHash, &it->second);
+    return &it->second;
+}
+
 void CGovernanceManager::AddCachedTriggers()
 {
     LOCK(cs);
@@ -1305,6 +1334,38 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("     %s\n", ToString());
 }
 
+void CGovernanceManager::ReconcileVotes()
+{
+    LOCK(cs);
+    if(!pgovernancevotedb) return;
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Reconciling governance objects with the vote database...\n");
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        if(!it->second.ReconcileVotes()) {
+            LogPrintf("CGovernanceManager::ReconcileVotes -- failed to read votes for %s\n", it->first.ToString());
+        }
+    }
+
+    // votes of objects which governance.dat doesn't know about are of no use
+    std::set<uint256> setParentHashes;
+    if(!pgovernancevotedb->ReadParentHashes(setParentHashes)) {
+        LogPrintf("CGovernanceManager::ReconcileVotes -- failed to read vote database\n");
+        return;
+    }
+    int nVotesErased = 0;
+    for(std::set<uint256>::iterator it = setParentHashes.begin(); it != setParentHashes.end(); ++it) {
+        if(mapObjects.count(*it)) continue;
+        std::vector<CGovernanceVote> vecVotes;
+        if(!pgovernancevotedb->ReadVotes(*it, vecVotes) || !pgovernancevotedb->EraseVotes(vecVotes)) {
+            LogPrintf("CGovernanceManager::ReconcileVotes -- failed to erase votes for %s\n", it->ToString());
+            continue;
+        }
+        nVotesErased += vecVotes.size();
+    }
+    LogPrintf("Governance votes reconciled, erased %d votes of unknown objects  %dms\n", nVotesErased, GetTimeMillis() - nStart);
+}
+
 std::string CGovernanceManager::ToString() const
 {
     LOCK(cs);
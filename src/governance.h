@@ -420,6 +420,9 @@ public:
 
     void InitOnLoad();
 
+    /// Match the loaded objects with the vote database after an unclean shutdown
+    void ReconcileVotes();
+
     int RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman);
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman);
 
@@ -450,6 +453,9 @@ private:
 
     void RebuildIndexes();
 
+    /// Find the object a vote belongs to, looking into the vote database if it's not indexed
+    CGovernanceObject* FindVoteParent(const uint256& nHash);
+
     void AddCachedTriggers();
 
     bool UpdateCurrentWatchdog(CGovernanceObject& watchdogNew);
@@ -0,0 +1,543 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "chainparams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+CIndexWriteQueue indexWriteQueue;
+
+bool CIndexWriteJob::HasAddress(const uint160& addressHash, int type) const
+{
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); ++it) {
+        if (it->first.hashBytes == addressHash && (int)it->first.type == type)
+            return true;
+    }
+    return false;
+}
+
+CIndexWriteQueue::CIndexWriteQueue() : fRunning(false), fStop(false), fFailed(false)
+{
+}
+
+CIndexWriteQueue::~CIndexWriteQueue()
+{
+    Stop();
+}
+
+void CIndexWriteQueue::Start()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fRunning)
+        return;
+    fRunning = true;
+    fStop = false;
+    thread = boost::thread(boost::bind(&CIndexWriteQueue::ThreadIndexWriter, this));
+}
+
+void CIndexWriteQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (!fRunning)
+            return;
+        fStop = true;
+    }
+    cond.notify_all();
+    thread.join();
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    fRunning = false;
+}
+
+bool CIndexWriteQueue::Push(CIndexWriteJob& job)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fFailed)
+            return false;
+        if (fRunning) {
+            while (queue.size() >= MAX_INDEX_WRITE_QUEUE_SIZE && !fFailed)
+                cond.wait(lock);
+            if (fFailed)
+                return false;
+            queue.push_back(CIndexWriteJob(job.fConnect));
+            CIndexWriteJob& jobQueued = queue.back();
+            jobQueued.fAddressIndex = job.fAddressIndex;
+            jobQueued.fAddressSummaryIndex = job.fAddressSummaryIndex;
+            jobQueued.fSpentIndex = job.fSpentIndex;
+            jobQueued.fTimestampIndex = job.fTimestampIndex;
+            jobQueued.addressIndex.swap(job.addressIndex);
+            jobQueued.addressUnspentIndex.swap(job.addressUnspentIndex);
+            jobQueued.spentIndex.swap(job.spentIndex);
+            jobQueued.timestampIndex.swap(job.timestampIndex);
+            cond.notify_all();
+            return true;
+        }
+    }
+
+    if (!Apply(job)) {
+        Fail(job);
+        return false;
+    }
+    return true;
+}
+
+bool CIndexWriteQueue::Flush()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (!queue.empty() && !fFailed)
+        cond.wait(lock);
+    return !fFailed;
+}
+
+void CIndexWriteQueue::GetPendingAddressIndex(const uint160& addressHash, int type, std::vector<std::pair<bool, std::pair<CAddressIndexKey, CAmount> > >& vPending)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    for (std::deque<CIndexWriteJob>::const_iterator itJob = queue.begin(); itJob != queue.end(); ++itJob) {
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = itJob->addressIndex.begin(); it != itJob->addressIndex.end(); ++it) {
+            if (it->first.hashBytes == addressHash && (int)it->first.type == type)
+                vPending.push_back(std::make_pair(!itJob->fConnect, *it));
+        }
+    }
+}
+
+void CIndexWriteQueue::GetPendingAddressUnspent(const uint160& addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vPending)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    for (std::deque<CIndexWriteJob>::const_iterator itJob = queue.begin(); itJob != queue.end(); ++itJob) {
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = itJob->addressUnspentIndex.begin(); it != itJob->addressUnspentIndex.end(); ++it) {
+            if (it->first.hashBytes == addressHash && (int)it->first.type == type)
+                vPending.push_back(*it);
+        }
+    }
+}
+
+bool CIndexWriteQueue::GetPendingSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    for (std::deque<CIndexWriteJob>::const_reverse_iterator itJob = queue.rbegin(); itJob != queue.rend(); ++itJob) {
+        for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_reverse_iterator it = itJob->spentIndex.rbegin(); it != itJob->spentIndex.rend(); ++it) {
+            if (it->first.txid == key.txid && it->first.outputIndex == key.outputIndex) {
+                value = it->second;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void CIndexWriteQueue::GetPendingTimestampIndex(unsigned int high, unsigned int low, std::vector<CTimestampIndexKey>& vPending)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    for (std::deque<CIndexWriteJob>::const_iterator itJob = queue.begin(); itJob != queue.end(); ++itJob) {
+        for (std::vector<CTimestampIndexKey>::const_iterator it = itJob->timestampIndex.begin(); it != itJob->timestampIndex.end(); ++it) {
+            if (it->timestamp >= low && it->timestamp <= high)
+                vPending.push_back(*it);
+        }
+    }
+}
+
+void CIndexWriteQueue::WaitForAddress(const uint160& addressHash, int type)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (!fFailed) {
+        bool fPending = false;
+        for (std::deque<CIndexWriteJob>::const_iterator itJob = queue.begin(); itJob != queue.end() && !fPending; ++itJob) {
+            fPending = itJob->HasAddress(addressHash, type);
+        }
+        if (!fPending)
+            break;
+        cond.wait(lock);
+    }
+}
+
+bool CIndexWriteQueue::Apply(const CIndexWriteJob& job)
+{
+    try {
+        if (job.fAddressIndex) {
+            if (job.fConnect ? !paddressindexdb->WriteAddressIndex(job.addressIndex, job.fAddressSummaryIndex) :
+                               !paddressindexdb->EraseAddressIndex(job.addressIndex, job.fAddressSummaryIndex))
+                return error("%s: failed to write address index", __func__);
+            if (!paddressindexdb->UpdateAddressUnspentIndex(job.addressUnspentIndex))
+                return error("%s: failed to write address unspent index", __func__);
+        }
+        if (job.fSpentIndex && !pspentindexdb->UpdateSpentIndex(job.spentIndex))
+            return error("%s: failed to write spent index", __func__);
+        if (job.fTimestampIndex) {
+            for (std::vector<CTimestampIndexKey>::const_iterator it = job.timestampIndex.begin(); it != job.timestampIndex.end(); ++it) {
+                if (!ptimestampindexdb->WriteTimestampIndex(*it))
+                    return error("%s: failed to write timestamp index", __func__);
+            }
+        }
+        return true;
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+}
+
+void CIndexWriteQueue::Fail(const CIndexWriteJob& job)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fFailed = true;
+    }
+    cond.notify_all();
+
+    // the chain moves on without the entries of this block,
+    // have the affected indexes built again on the next start
+    if (job.fAddressIndex) {
+        pblocktree->WriteFlag("addressindex", false);
+        pblocktree->WriteFlag("addresssummaryindex", false);
+    }
+    if (job.fSpentIndex)
+        pblocktree->WriteFlag("spentindex", false);
+    if (job.fTimestampIndex)
+        pblocktree->WriteFlag("timestampindex", false);
+
+    AbortNode("Failed to write to index database");
+}
+
+void CIndexWriteQueue::ThreadIndexWriter()
+{
+    RenameThread("sparks-indexwriter");
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (queue.empty() && !fStop)
+            cond.wait(lock);
+        if (queue.empty() || fFailed)
+            break;
+
+        // the job stays queued while it is applied, readers and Flush() see it meanwhile.
+        // Queued jobs are not moved by push_back, the reference stays valid.
+        const CIndexWriteJob& job = queue.front();
+        lock.unlock();
+        bool fOk = Apply(job);
+        if (!fOk)
+            Fail(job);
+        lock.lock();
+
+        if (!fOk)
+            break;
+        queue.pop_front();
+        cond.notify_all();
+    }
+}
+
+/** A block to (un)index along with everything needed to do so outside of cs_main */
+struct CIndexBuildBlock
+{
+    const CBlockIndex* pindex;
+    int nHeight;
+    unsigned int nTime;
+    uint256 hashBlock;
+    uint256 hashPrevBlock;
+    CDiskBlockPos posUndo;
+
+    bool fOk;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    CIndexBuildBlock(const CBlockIndex* pindexIn) :
+        pindex(pindexIn),
+        nHeight(pindexIn->nHeight),
+        nTime(pindexIn->nTime),
+        hashBlock(pindexIn->GetBlockHash()),
+        hashPrevBlock(pindexIn->pprev ? pindexIn->pprev->GetBlockHash() : uint256()),
+        posUndo(pindexIn->GetUndoPos()),
+        fOk(false)
+    {}
+};
+
+static int GetIndexAddress(const CScript& script, uint160& hashBytes)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        return 2;
+    }
+    if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        return 1;
+    }
+    hashBytes.SetNull();
+    return 0;
+}
+
+/**
+ * Read a block and its undo data from disk and compute the index entries ConnectBlock
+ * (fConnect) or DisconnectBlock (!fConnect) would have written for it.
+ */
+static bool ReadIndexBuildBlock(CIndexBuildBlock& item, const CIndexBuildProgress& progress, bool fConnect)
+{
+    // checked against the block index rather than by rehashing, the blocks were validated already
+    CBlock block;
+    if (!ReadBlockFromDisk(block, item.pindex, Params().GetConsensus()))
+        return error("%s: failed to read block %s", __func__, item.hashBlock.ToString());
+
+    CBlockUndo blockUndo;
+    if (!UndoReadFromDisk(blockUndo, item.posUndo, item.hashPrevBlock))
+        return error("%s: failed to read undo data of block %s", __func__, item.hashBlock.ToString());
+
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block %s and undo data inconsistent", __func__, item.hashBlock.ToString());
+
+    for (unsigned int n = 0; n < block.vtx.size(); n++) {
+        // disconnecting has to undo transactions in reverse order
+        unsigned int i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (!fConnect && progress.fAddressIndex) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                uint160 hashBytes;
+                int addressType = GetIndexAddress(tx.vout[k].scriptPubKey, hashBytes);
+                if (addressType == 0)
+                    continue;
+                item.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, item.nHeight, i, txhash, k, false), tx.vout[k].nValue));
+                item.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue()));
+            }
+        }
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockUndo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction %s and undo data inconsistent", __func__, txhash.ToString());
+
+            for (unsigned int m = 0; m < tx.vin.size(); m++) {
+                unsigned int j = fConnect ? m : tx.vin.size() - 1 - m;
+                const COutPoint& outpoint = tx.vin[j].prevout;
+                const Coin& coin = txundo.vprevout[j];
+                uint160 hashBytes;
+                int addressType = GetIndexAddress(coin.out.scriptPubKey, hashBytes);
+
+                if (progress.fAddressIndex && addressType > 0) {
+                    item.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, item.nHeight, i, txhash, j, true), coin.out.nValue * -1));
+                    item.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, outpoint.hash, outpoint.n),
+                                                                      fConnect ? CAddressUnspentValue() : CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight)));
+                }
+
+                if (progress.fSpentIndex) {
+                    item.spentIndex.push_back(std::make_pair(CSpentIndexKey(outpoint.hash, outpoint.n),
+                                                             fConnect ? CSpentIndexValue(txhash, j, item.nHeight, coin.out.nValue, addressType, hashBytes) : CSpentIndexValue()));
+                }
+            }
+        }
+
+        if (fConnect && progress.fAddressIndex) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                uint160 hashBytes;
+                int addressType = GetIndexAddress(tx.vout[k].scriptPubKey, hashBytes);
+                if (addressType == 0)
+                    continue;
+                item.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, item.nHeight, i, txhash, k, false), tx.vout[k].nValue));
+                item.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue(tx.vout[k].nValue, tx.vout[k].scriptPubKey, item.nHeight)));
+            }
+        }
+    }
+
+    return true;
+}
+
+static void ReadIndexBuildBlocks(std::vector<CIndexBuildBlock>* pvBlocks, const CIndexBuildProgress progress, size_t nStart, size_t nStep)
+{
+    for (size_t i = nStart; i < pvBlocks->size(); i += nStep) {
+        boost::this_thread::interruption_point();
+        (*pvBlocks)[i].fOk = ReadIndexBuildBlock((*pvBlocks)[i], progress, true);
+    }
+}
+
+static bool WriteIndexBuildBlock(const CIndexBuildBlock& item, const CIndexBuildProgress& progress, bool fConnect)
+{
+    if (progress.fAddressIndex) {
+        if (fConnect ? !paddressindexdb->WriteAddressIndex(item.addressIndex, true) : !paddressindexdb->EraseAddressIndex(item.addressIndex, true))
+            return error("%s: failed to write address index", __func__);
+        if (!paddressindexdb->UpdateAddressUnspentIndex(item.addressUnspentIndex))
+            return error("%s: failed to write address unspent index", __func__);
+    }
+
+    if (progress.fSpentIndex && !pspentindexdb->UpdateSpentIndex(item.spentIndex))
+        return error("%s: failed to write spent index", __func__);
+
+    // like DisconnectBlock, leave timestamps of disconnected blocks in place
+    if (progress.fTimestampIndex && fConnect && !ptimestampindexdb->WriteTimestampIndex(CTimestampIndexKey(item.nTime, item.hashBlock)))
+        return error("%s: failed to write timestamp index", __func__);
+
+    return true;
+}
+
+/** Turn the built indexes on, from now on they are updated by ConnectBlock/DisconnectBlock */
+static bool FinishIndexBuild(const CIndexBuildProgress& progress)
+{
+    AssertLockHeld(cs_main);
+
+    if (progress.fAddressIndex) {
+        if (!pblocktree->WriteFlag("addressindex", true) || !pblocktree->WriteFlag("addresssummaryindex", true))
+            return false;
+        fAddressIndex = true;
+        fAddressSummaryIndex = true;
+    }
+    if (progress.fSpentIndex) {
+        if (!pblocktree->WriteFlag("spentindex", true))
+            return false;
+        fSpentIndex = true;
+    }
+    if (progress.fTimestampIndex) {
+        if (!pblocktree->WriteFlag("timestampindex", true))
+            return false;
+        fTimestampIndex = true;
+    }
+
+    return pblocktree->EraseIndexBuildProgress();
+}
+
+bool BuildIndexes(CIndexBuildProgress& progress, int nThreads)
+{
+    int64_t nStart = GetTimeMillis();
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        std::vector<CIndexBuildBlock> vBlocks;
+        {
+            LOCK(cs_main);
+
+            const CBlockIndex* pindexBest = chainActive.Genesis();
+            if (!progress.hashBestBlock.IsNull()) {
+                BlockMap::const_iterator mi = mapBlockIndex.find(progress.hashBestBlock);
+                if (mi != mapBlockIndex.end())
+                    pindexBest = mi->second;
+            }
+
+            if (pindexBest != NULL) {
+                // undo blocks which were indexed but are no longer part of the active chain
+                while (!chainActive.Contains(pindexBest)) {
+                    CIndexBuildBlock item(pindexBest);
+                    if (!ReadIndexBuildBlock(item, progress, false) || !WriteIndexBuildBlock(item, progress, false))
+                        return error("%s: failed to disconnect block %s, index build stopped", __func__, item.hashBlock.ToString());
+                    pindexBest = pindexBest->pprev;
+                    progress.hashBestBlock = pindexBest->GetBlockHash();
+                    pblocktree->WriteIndexBuildProgress(progress);
+                }
+
+                if (pindexBest == chainActive.Tip()) {
+                    if (!FinishIndexBuild(progress))
+                        return error("%s: failed to enable indexes", __func__);
+                    LogPrintf("%s: indexes built up to height %d in %.2fs\n", __func__, pindexBest->nHeight, 0.001 * (GetTimeMillis() - nStart));
+                    return true;
+                }
+
+                for (const CBlockIndex* pindex = chainActive.Next(pindexBest); pindex != NULL && (int)vBlocks.size() < INDEX_BUILDER_BATCH_SIZE; pindex = chainActive.Next(pindex)) {
+                    vBlocks.push_back(CIndexBuildBlock(pindex));
+                }
+            }
+        }
+
+        if (vBlocks.empty()) {
+            // the genesis block is not loaded yet
+            MilliSleep(1000);
+            continue;
+        }
+
+        // reading and processing blocks is what takes time, spread it over several threads
+        boost::thread_group readers;
+        for (int i = 0; i < nThreads; i++) {
+            readers.create_thread(boost::bind(&ReadIndexBuildBlocks, &vBlocks, progress, i, nThreads));
+        }
+        try {
+            readers.join_all();
+        } catch (const boost::thread_interrupted&) {
+            boost::this_thread::disable_interruption di;
+            readers.interrupt_all();
+            readers.join_all();
+            throw;
+        }
+
+        // blocks have to be written in order, the unspent index depends on it
+        for (std::vector<CIndexBuildBlock>::const_iterator it = vBlocks.begin(); it != vBlocks.end(); ++it) {
+            if (!it->fOk || !WriteIndexBuildBlock(*it, progress, true))
+                return error("%s: failed to index block %s, index build stopped", __func__, it->hashBlock.ToString());
+            progress.hashBestBlock = it->hashBlock;
+            pblocktree->WriteIndexBuildProgress(progress);
+        }
+
+        LogPrintf("%s: indexed up to height %d\n", __func__, vBlocks.back().nHeight);
+    }
+}
+
+static void ThreadIndexBuilder(CIndexBuildProgress progress, bool fEraseLegacy)
+{
+    if (fEraseLegacy) {
+        LogPrintf("%s: erasing index entries left in the block tree database\n", __func__);
+        if (pblocktree->EraseLegacyIndexes())
+            pblocktree->WriteFlag("legacyindexes", false);
+    }
+
+    if (progress.IsNull())
+        return;
+
+    BuildIndexes(progress, std::max(1, std::min(GetNumCores(), MAX_INDEX_BUILDER_THREADS)));
+}
+
+bool PrepareIndexBuild(CIndexBuildProgress& wanted)
+{
+    CIndexBuildProgress progress;
+    bool fResume = pblocktree->ReadIndexBuildProgress(progress);
+
+    if (wanted.IsNull()) {
+        if (fResume)
+            pblocktree->EraseIndexBuildProgress();
+        return true;
+    }
+
+    // continue where the last build stopped unless an index was added, entries are
+    // idempotent so a build can safely start over from the genesis block
+    if (fResume && (progress.fAddressIndex || !wanted.fAddressIndex) && (progress.fSpentIndex || !wanted.fSpentIndex) &&
+        (progress.fTimestampIndex || !wanted.fTimestampIndex)) {
+        wanted.hashBestBlock = progress.hashBestBlock;
+    } else {
+        wanted.hashBestBlock.SetNull();
+    }
+
+    if (!pblocktree->WriteIndexBuildProgress(wanted))
+        return error("%s: failed to write index build progress", __func__);
+
+    LogPrintf("%s: building%s%s%s in the background, starting after block %s\n", __func__,
+              wanted.fAddressIndex ? " addressindex" : "", wanted.fSpentIndex ? " spentindex" : "",
+              wanted.fTimestampIndex ? " timestampindex" : "",
+              wanted.hashBestBlock.IsNull() ? "genesis" : wanted.hashBestBlock.ToString());
+    return true;
+}
+
+void StartIndexBuilder(boost::thread_group& threadGroup)
+{
+    CIndexBuildProgress wanted;
+    wanted.fAddressIndex = !fAddressIndex && GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    wanted.fSpentIndex = !fSpentIndex && GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    wanted.fTimestampIndex = !fTimestampIndex && GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+
+    // index entries of databases created before the indexes had their own are cleaned up in the background
+    bool fEraseLegacy = false;
+    pblocktree->ReadFlag("legacyindexes", fEraseLegacy);
+
+    if (!wanted.IsNull() && (fHavePruned || fPruneMode)) {
+        LogPrintf("%s: indexes can not be built from a pruned block database, restart with -reindex\n", __func__);
+        wanted.SetNull();
+    }
+
+    if (!PrepareIndexBuild(wanted))
+        return;
+    if (wanted.IsNull() && !fEraseLegacy)
+        return;
+
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "indexbuilder", boost::function<void()>(boost::bind(&ThreadIndexBuilder, wanted, fEraseLegacy))));
+}
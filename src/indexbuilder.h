@@ -0,0 +1,132 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEXBUILDER_H
+#define INDEXBUILDER_H
+
+#include "spentindex.h"
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+/** Number of blocks read from disk and processed in parallel per batch */
+static const int INDEX_BUILDER_BATCH_SIZE = 500;
+/** Maximum number of threads reading blocks for the index builder */
+static const int MAX_INDEX_BUILDER_THREADS = 8;
+/** Number of queued index writes after which block connection waits for the writer to catch up */
+static const size_t MAX_INDEX_WRITE_QUEUE_SIZE = 1000;
+
+/** Index database updates of one connected (fConnect) or disconnected block */
+struct CIndexWriteJob
+{
+    bool fConnect;
+    bool fAddressIndex;
+    bool fAddressSummaryIndex;
+    bool fSpentIndex;
+    bool fTimestampIndex;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<CTimestampIndexKey> timestampIndex;
+
+    CIndexWriteJob(bool fConnectIn) :
+        fConnect(fConnectIn),
+        fAddressIndex(false),
+        fAddressSummaryIndex(false),
+        fSpentIndex(false),
+        fTimestampIndex(false)
+    {}
+
+    bool IsNull() const
+    {
+        return !fAddressIndex && !fSpentIndex && !fTimestampIndex;
+    }
+
+    bool HasAddress(const uint160& addressHash, int type) const;
+};
+
+/**
+ * Applies index database writes of connected and disconnected blocks in a background
+ * thread, in the order they were queued, so block connection does not wait for them.
+ * Writes are applied immediately while the writer thread is not running.
+ *
+ * Readers don't wait for the writer, the GetPending* methods return the queued updates
+ * matching a query so they can be applied on top of what the databases return. A job
+ * stays queued until it is written, so whatever is no longer pending can be read from
+ * the databases. Results which already contain some of the pending updates are fine,
+ * writing or erasing an entry a second time has no further effect.
+ *
+ * A failed write stops the node, the indexes it touched are marked as missing so
+ * they are built again from the blocks on disk on the next start.
+ */
+class CIndexWriteQueue
+{
+public:
+    CIndexWriteQueue();
+    ~CIndexWriteQueue();
+
+    void Start();
+    /** Apply everything still queued and stop the writer thread */
+    void Stop();
+    /** Queue the updates of a block, its vectors are moved out of job. Returns false if an index write failed */
+    bool Push(CIndexWriteJob& job);
+    /** Wait until everything queued so far is written, returns false if a write failed */
+    bool Flush();
+
+    /** Queued address index updates of an address in order, paired with whether they erase the entry */
+    void GetPendingAddressIndex(const uint160& addressHash, int type, std::vector<std::pair<bool, std::pair<CAddressIndexKey, CAmount> > >& vPending);
+    /** Queued unspent index updates of an address in order, a null value erases the entry */
+    void GetPendingAddressUnspent(const uint160& addressHash, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vPending);
+    /** Latest queued spent index update of key, returns false if there is none. A null value means erased */
+    bool GetPendingSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+    /** Queued timestamp index entries between low and high */
+    void GetPendingTimestampIndex(unsigned int high, unsigned int low, std::vector<CTimestampIndexKey>& vPending);
+    /** Wait until no queued update touches the summary of an address, summaries can't be replayed */
+    void WaitForAddress(const uint160& addressHash, int type);
+
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<CIndexWriteJob> queue;
+    bool fRunning;
+    bool fStop;
+    bool fFailed;
+    boost::thread thread;
+
+    void ThreadIndexWriter();
+    bool Apply(const CIndexWriteJob& job);
+    void Fail(const CIndexWriteJob& job);
+};
+
+extern CIndexWriteQueue indexWriteQueue;
+
+struct CIndexBuildProgress;
+
+/**
+ * Set up the build of the indexes in wanted and store it as the build progress. A build
+ * stored earlier is resumed when it covers all of the wanted indexes, otherwise the build
+ * starts over from the genesis block. An empty wanted discards any stored build.
+ */
+bool PrepareIndexBuild(CIndexBuildProgress& wanted);
+
+/**
+ * Index the blocks of the active chain after progress.hashBestBlock using nThreads reading
+ * threads, undoing blocks which were indexed but left the active chain first. Progress is
+ * stored after each block. Returns true once the tip was reached and the indexes are enabled.
+ */
+bool BuildIndexes(CIndexBuildProgress& progress, int nThreads);
+
+/**
+ * Build the address, spent and timestamp indexes that are enabled on the command line
+ * but missing from the block tree database. Blocks are indexed from disk in a background
+ * thread, progress is stored so an interrupted build resumes where it stopped. Once the
+ * builder has caught up with the active chain the indexes are enabled and maintained by
+ * ConnectBlock/DisconnectBlock as usual. Entries left in the block tree database by
+ * versions which kept the indexes there are erased by the same thread.
+ */
+void StartIndexBuilder(boost::thread_group& threadGroup);
+
+#endif // INDEXBUILDER_H
@@ -20,6 +20,7 @@
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -50,6 +51,7 @@
 #include "dsnotificationinterface.h"
 #include "flat-database.h"
 #include "governance.h"
+#include "governance-votedb.h"
 #include "instantx.h"
 #ifdef ENABLE_WALLET
 #include "keepass.h"
@@ -208,6 +210,25 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+/** Load a Sparks data cache from its serialized dat file */
+template<typename T>
+static void LoadSparksCache(const std::string& strFilename, const std::string& strMagicMessage, T& objToLoad, bool& fResult)
+{
+    CFlatDB<T> flatdb(strFilename, strMagicMessage);
+    fResult = flatdb.Load(objToLoad);
+}
+
+static void LoadGovernanceCache(bool fReconcileVotes, bool& fResult)
+{
+    LoadSparksCache(std::string("governance.dat"), std::string("magicGovernanceCache"), governance, fResult);
+    if(fResult) {
+        if(fReconcileVotes) {
+            governance.ReconcileVotes();
+        }
+        governance.InitOnLoad();
+    }
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 void PrepareShutdown()
 {
@@ -246,6 +267,12 @@ void PrepareShutdown()
     flatdb2.Dump(mnpayments);
     CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
     flatdb3.Dump(governance);
+    if (pgovernancevotedb) {
+        // votes on disk match governance.dat now
+        pgovernancevotedb->WriteCleanShutdown(true);
+        delete pgovernancevotedb;
+        pgovernancevotedb = NULL;
+    }
     CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
     flatdb4.Dump(netfulfilledman);
 
@@ -267,6 +294,7 @@ void PrepareShutdown()
         if (pcoinsTip != NULL) {
             FlushStateToDisk();
         }
+        indexWriteQueue.Stop();
         delete pcoinsTip;
         pcoinsTip = NULL;
         delete pcoinscatcher;
@@ -275,6 +303,12 @@ void PrepareShutdown()
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete paddressindexdb;
+        paddressindexdb = NULL;
+        delete pspentindexdb;
+        pspentindexdb = NULL;
+        delete ptimestampindexdb;
+        ptimestampindexdb = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -413,6 +447,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-parcheck=<n>", strprintf(_("Set the number of threads for header proof-of-work and masternode signature checks (0 to %d, default: %d)"),
+        MAX_PARCHECK_THREADS, DEFAULT_PARCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -446,6 +482,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (temporary service connections excluded) (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("Socket events mode, which must be one of: %s (default: %s)"), GetSupportedSocketEventsModes(), GetSocketEventsModeName(DEFAULT_SOCKETEVENTS)));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -528,6 +565,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindexpow", strprintf("Recompute the proof-of-work hash of every block header in parallel when loading the block index (default: %u)", DEFAULT_CHECKBLOCKINDEXPOW));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
 #ifdef ENABLE_WALLET
@@ -567,6 +605,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxmsgsigcachesize=<n>", strprintf("Limit size of masternode message signature cache to <n> MiB (default: %u)", DEFAULT_MAX_MESSAGE_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -602,6 +641,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-enableinstantsend=<n>", strprintf(_("Enable InstantSend, show confirmations for locked transactions (0-1, default: %u)"), 1));
     strUsage += HelpMessageOpt("-instantsenddepth=<n>", strprintf(_("Show N confirmations for a successfully locked transaction (0-9999, default: %u)"), DEFAULT_INSTANTSEND_DEPTH));
     strUsage += HelpMessageOpt("-instantsendnotify=<cmd>", _("Execute command when a wallet InstantSend transaction is successfully locked (%s in cmd is replaced by TxID)"));
+    strUsage += HelpMessageOpt("-maxinstantsendsize=<n>", strprintf(_("Keep InstantSend lock data in memory below <n> megabytes, completed locks are never evicted (default: %u)"), DEFAULT_MAX_INSTANTSEND_SIZE));
 
 
     strUsage += HelpMessageGroup(_("Node relay options:"));
@@ -1036,8 +1076,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     int nMaxConnections = std::max(nUserMaxConnections, 0);
 
+    SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
+    if (mapArgs.count("-socketevents") && !ParseSocketEventsMode(GetArg("-socketevents", ""), socketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), GetArg("-socketevents", ""), GetSupportedSocketEventsModes()));
+
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    // (only select() can't handle sockets numbered FD_SETSIZE or higher)
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1099,6 +1145,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // the calling thread works on these checks too, 0 means no concurrency
+    nParCheckThreads = std::max(0, std::min((int)GetArg("-parcheck", DEFAULT_PARCHECK_THREADS), MAX_PARCHECK_THREADS));
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1282,6 +1331,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    LogPrintf("Using %u threads for header proof-of-work and masternode signature checks\n", nParCheckThreads);
+    for (int i=0; i<nParCheckThreads; i++)
+        threadGroup.create_thread(&ThreadParallelCheck);
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1531,6 +1584,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    // optional indexes have databases of their own, each gets an equal share of another 1/8th
+    int nIndexes = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) + GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) + GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    int64_t nIndexDBCache = nIndexes > 0 ? std::min(nTotalCache / 8 / nIndexes, nMaxIndexDBCache << 20) : 0;
+    nTotalCache -= nIndexDBCache * nIndexes;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1538,6 +1595,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nIndexes > 0)
+        LogPrintf("* Using %.1fMiB for each of %d index databases\n", nIndexDBCache * (1.0 / 1024 / 1024), nIndexes);
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
@@ -1556,8 +1615,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
+                delete paddressindexdb;
+                delete pspentindexdb;
+                delete ptimestampindexdb;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                paddressindexdb = new CAddressIndexDB(GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ? nIndexDBCache : nMinIndexDBCache << 20, false, fReindex);
+                pspentindexdb = new CSpentIndexDB(GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ? nIndexDBCache : nMinIndexDBCache << 20, false, fReindex);
+                ptimestampindexdb = new CTimestampIndexDB(GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ? nIndexDBCache : nMinIndexDBCache << 20, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
@@ -1884,6 +1949,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+
+    // Write index updates of connected blocks in the background
+    indexWriteQueue.Start();
+
+    // Build indexes which were enabled after the block database was created
+    StartIndexBuilder(threadGroup);
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -1950,6 +2021,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fEnableInstantSend = GetBoolArg("-enableinstantsend", 1);
     nInstantSendDepth = GetArg("-instantsenddepth", DEFAULT_INSTANTSEND_DEPTH);
     nInstantSendDepth = std::min(std::max(nInstantSendDepth, 0), 60);
+    instantsend.SetMaxMemoryUsage(std::max(GetArg("-maxinstantsendsize", DEFAULT_MAX_INSTANTSEND_SIZE), (int64_t)0) * 1000000);
 
     //lite mode disables all Masternode and Darksend related functionality
     fLiteMode = GetBoolArg("-litemode", false);
@@ -1971,39 +2043,53 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
 
     boost::filesystem::path pathDB = GetDataDir();
-    std::string strDBName;
 
-    strDBName = "mncache.dat";
+    // caches don't depend on each other while being read, load them in parallel
+    bool fMasternodesLoaded = false;
+    bool fFulfilledLoaded = false;
     uiInterface.InitMessage(_("Loading masternode cache..."));
-    CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
-    if(!flatdb1.Load(mnodeman)) {
-        return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
+    {
+        boost::thread_group loadThreads;
+        loadThreads.create_thread(boost::bind(&LoadSparksCache<CNetFulfilledRequestManager>, std::string("netfulfilled.dat"), std::string("magicFulfilledCache"), boost::ref(netfulfilledman), boost::ref(fFulfilledLoaded)));
+        LoadSparksCache(std::string("mncache.dat"), std::string("magicMasternodeCache"), mnodeman, fMasternodesLoaded);
+        loadThreads.join_all();
     }
+    if(!fMasternodesLoaded) {
+        return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / "mncache.dat").string());
+    }
+    if(!fFulfilledLoaded) {
+        return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / "netfulfilled.dat").string());
+    }
+
+    pgovernancevotedb = new CGovernanceVoteDB(nGovernanceVoteDBCache << 20);
+    bool fGovernanceVotesClean = pgovernancevotedb->ReadCleanShutdown();
+    // until the next clean shutdown votes on disk may not match governance.dat
+    pgovernancevotedb->WriteCleanShutdown(false);
 
     if(mnodeman.size()) {
-        strDBName = "mnpayments.dat";
-        uiInterface.InitMessage(_("Loading masternode payment cache..."));
-        CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache");
-        if(!flatdb2.Load(mnpayments)) {
-            return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
+        bool fPaymentsLoaded = false;
+        bool fGovernanceLoaded = true;
+        uiInterface.InitMessage(_("Loading masternode payment and governance caches..."));
+        {
+            boost::thread_group loadThreads;
+            // after an unclean shutdown the vote database may hold votes governance.dat doesn't know about
+            loadThreads.create_thread(boost::bind(&LoadGovernanceCache, !fGovernanceVotesClean, boost::ref(fGovernanceLoaded)));
+            LoadSparksCache(std::string("mnpayments.dat"), std::string("magicMasternodePaymentsCache"), mnpayments, fPaymentsLoaded);
+            loadThreads.join_all();
         }
-
-        strDBName = "governance.dat";
-        uiInterface.InitMessage(_("Loading governance cache..."));
-        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
-        if(!flatdb3.Load(governance)) {
-            return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+        if(!fPaymentsLoaded) {
+            return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / "mnpayments.dat").string());
+        }
+        if(!fGovernanceLoaded) {
+            return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / "governance.dat").string());
         }
-        governance.InitOnLoad();
     } else {
         uiInterface.InitMessage(_("Masternode cache is empty, skipping payments and governance cache..."));
-    }
-
-    strDBName = "netfulfilled.dat";
-    uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-    CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
-    if(!flatdb4.Load(netfulfilledman)) {
-        return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
+        // governance objects and their votes have to be synced from scratch,
+        // the database would keep stale votes otherwise
+        LogPrintf("Governance cache was not loaded, wiping governance vote database\n");
+        delete pgovernancevotedb;
+        pgovernancevotedb = new CGovernanceVoteDB(nGovernanceVoteDBCache << 20, false, true);
     }
 
     // ********************************************************* Step 11c: update block tip in Sparks modules
@@ -2013,9 +2099,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // GetMainSignals().UpdatedBlockTip(chainActive.Tip());
     pdsNotificationInterface->InitializeCurrentBlockTip();
 
-    // ********************************************************* Step 11d: start sparks-ps-<smth> threads
+    // ********************************************************* Step 11d: start sparks-ps-<smth> and sparks-is-votes threads
 
     threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSend, boost::ref(*g_connman)));
+    threadGroup.create_thread(boost::bind(&ThreadCheckTxLockVotes, boost::ref(*g_connman)));
     if (fMasterNode)
         threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSendServer, boost::ref(*g_connman)));
 #ifdef ENABLE_WALLET
@@ -2067,6 +2154,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.uiInterface = &uiInterface;
     connOptions.nSendBufferMaxSize = 1000*GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.socketEventsMode = socketEventsMode;
 
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
@@ -3,13 +3,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "activemasternode.h"
+#include "core_memusage.h"
 #include "instantx.h"
 #include "key.h"
 #include "validation.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "memusage.h"
 #include "messagesigner.h"
 #include "net.h"
+#include "net_processing.h"
 #include "protocol.h"
 #include "spork.h"
 #include "sync.h"
@@ -68,17 +71,33 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         // Ignore any InstantSend messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
-        LOCK(cs_main);
-#ifdef ENABLE_WALLET
-        if (pwalletMain)
-            LOCK(pwalletMain->cs_wallet);
-#endif
-        LOCK(cs_instantsend);
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+            if(filterRejectedTxLockVotes.contains(nVoteHash)) return;
+        }
 
-        if(mapTxLockVotes.count(nVoteHash)) return;
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        if(!mnodeman.Has(vote.GetMasternodeOutpoint())) {
+            LogPrint("instantsend", "CInstantSend::ProcessMessage -- Unknown masternode %s\n", vote.GetMasternodeOutpoint().ToStringShort());
+            mnodeman.AskForMN(pfrom, vote.GetMasternodeOutpoint(), connman);
+            return;
+        }
 
-        ProcessTxLockVote(pfrom, vote, connman);
+        // Ranks and signatures are checked by ThreadCheckTxLockVotes,
+        // don't hold up the message handler thread here.
+        // The vote is only stored once it passed these checks.
+        {
+            boost::unique_lock<boost::mutex> lock(csPendingTxLockVotes);
+            int& nPending = mapPendingTxLockVotesCount[pfrom->id];
+            if(nPending >= MAX_PENDING_TXLOCKVOTES_PER_PEER) {
+                LogPrint("instantsend", "CInstantSend::ProcessMessage -- Too many pending votes, dropping vote hash=%s, peer=%d\n", nVoteHash.ToString(), pfrom->id);
+                return;
+            }
+            ++nPending;
+            vecPendingTxLockVotes.push_back(std::make_pair(pfrom->id, vote));
+            nPendingTxLockVotesMemoryUsage += vote.DynamicMemoryUsage();
+        }
+        condPendingTxLockVotes.notify_one();
 
         return;
     }
@@ -92,7 +111,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
 
     // Check to see if we conflict with existing completed lock
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        std::unordered_map<COutPoint, uint256, SaltedOutpointHasher>::iterator it = mapLockedOutpoints.find(txin.prevout);
         if(it != mapLockedOutpoints.end() && it->second != txLockRequest.GetHash()) {
             // Conflicting with complete lock, proceed to see if we should cancel them both
             LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, txid=%s, completed lock txid=%s\n",
@@ -103,7 +122,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Check to see if there are votes for conflicting request,
     // if so - do not fail, just warn user
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher>::iterator it = mapVotedOutpoints.find(txin.prevout);
         if(it != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, it->second) {
                 if(hash != txLockRequest.GetHash()) {
@@ -125,7 +144,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
     // forcing external script notification.
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     TryToFinalizeLockCandidate(itLockCandidate->second);
 
     return true;
@@ -139,7 +158,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     uint256 txHash = txLockRequest.GetHash();
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) {
         LogPrintf("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
@@ -149,10 +168,14 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
             txLockCandidate.AddOutPointLock(txin.prevout);
         }
         mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
+        queueTxLockCandidates.push_back(std::make_pair(GetTime(), txHash));
+        nObjectsMemoryUsage += txLockCandidate.DynamicMemoryUsage();
     } else if (!itLockCandidate->second.txLockRequest) {
         // i.e. empty Transaction Lock Candidate was created earlier, let's update it with actual data
+        nObjectsMemoryUsage -= itLockCandidate->second.DynamicMemoryUsage();
         itLockCandidate->second.txLockRequest = txLockRequest;
         if (itLockCandidate->second.IsTimedOut()) {
+            nObjectsMemoryUsage += itLockCandidate->second.DynamicMemoryUsage();
             LogPrintf("CInstantSend::CreateTxLockCandidate -- timed out, txid=%s\n", txHash.ToString());
             return false;
         }
@@ -162,6 +185,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
         BOOST_REVERSE_FOREACH(const CTxIn& txin, txLockRequest.vin) {
             itLockCandidate->second.AddOutPointLock(txin.prevout);
         }
+        nObjectsMemoryUsage += itLockCandidate->second.DynamicMemoryUsage();
     } else {
         LogPrint("instantsend", "CInstantSend::CreateTxLockCandidate -- seen, txid=%s\n", txHash.ToString());
     }
@@ -175,7 +199,137 @@ void CInstantSend::CreateEmptyTxLockCandidate(const uint256& txHash)
         return;
     LogPrintf("CInstantSend::CreateEmptyTxLockCandidate -- new, txid=%s\n", txHash.ToString());
     const CTxLockRequest txLockRequest = CTxLockRequest();
-    mapTxLockCandidates.insert(std::make_pair(txHash, CTxLockCandidate(txLockRequest)));
+    CTxLockCandidate txLockCandidate(txLockRequest);
+    mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
+    queueTxLockCandidates.push_back(std::make_pair(GetTime(), txHash));
+    nObjectsMemoryUsage += txLockCandidate.DynamicMemoryUsage();
+}
+
+void CInstantSend::RemoveTxLockCandidate(txlockcandidate_map_t::iterator itLockCandidate)
+{
+    AssertLockHeld(cs_instantsend);
+
+    CTxLockCandidate& txLockCandidate = itLockCandidate->second;
+    uint256 txHash = txLockCandidate.GetHash();
+
+    std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+    while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+        std::unordered_map<COutPoint, uint256, SaltedOutpointHasher>::iterator itLocked = mapLockedOutpoints.find(itOutpointLock->first);
+        if(itLocked != mapLockedOutpoints.end() && itLocked->second == txHash) {
+            mapLockedOutpoints.erase(itLocked);
+        }
+        RemoveVotedOutpoint(itOutpointLock->first, txHash);
+        ++itOutpointLock;
+    }
+
+    // votes are only kept for as long as the lock they belong to,
+    // this includes votes which never made it into the candidate
+    std::unordered_map<uint256, std::set<uint256>, SaltedTxidHasher>::iterator itTxVotes = mapTxLockVoteHashes.find(txHash);
+    if(itTxVotes != mapTxLockVoteHashes.end()) {
+        std::set<uint256> setVoteHashes = itTxVotes->second;
+        BOOST_FOREACH(const uint256& nVoteHash, setVoteHashes) {
+            RemoveTxLockVote(nVoteHash);
+        }
+    }
+
+    txlockrequest_map_t::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+    if(itLockRequest != mapLockRequestAccepted.end()) {
+        nObjectsMemoryUsage -= RecursiveDynamicUsage(itLockRequest->second);
+        mapLockRequestAccepted.erase(itLockRequest);
+    }
+    itLockRequest = mapLockRequestRejected.find(txHash);
+    if(itLockRequest != mapLockRequestRejected.end()) {
+        nObjectsMemoryUsage -= RecursiveDynamicUsage(itLockRequest->second);
+        mapLockRequestRejected.erase(itLockRequest);
+    }
+
+    nObjectsMemoryUsage -= txLockCandidate.DynamicMemoryUsage();
+    mapTxLockCandidates.erase(itLockCandidate);
+}
+
+bool CInstantSend::AddLockRequest(txlockrequest_map_t& mapLockRequests, const CTxLockRequest& txLockRequest)
+{
+    AssertLockHeld(cs_instantsend);
+
+    if(!mapLockRequests.insert(std::make_pair(txLockRequest.GetHash(), txLockRequest)).second) return false;
+    nObjectsMemoryUsage += RecursiveDynamicUsage(txLockRequest);
+    return true;
+}
+
+bool CInstantSend::AddTxLockVote(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    if(!mapTxLockVotes.insert(std::make_pair(vote.GetHash(), vote)).second) return false;
+    queueTxLockVotes.push_back(std::make_pair(GetTime(), vote.GetHash()));
+    nObjectsMemoryUsage += vote.DynamicMemoryUsage();
+
+    std::set<uint256>& setVoteHashes = mapTxLockVoteHashes[vote.GetTxHash()];
+    nObjectsMemoryUsage -= memusage::DynamicUsage(setVoteHashes);
+    setVoteHashes.insert(vote.GetHash());
+    nObjectsMemoryUsage += memusage::DynamicUsage(setVoteHashes);
+    return true;
+}
+
+void CInstantSend::AddTxLockVoteOrphan(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    if(!mapTxLockVotesOrphan.insert(std::make_pair(vote.GetHash(), vote)).second) return;
+    queueTxLockVotesOrphan.push_back(std::make_pair(GetTime(), vote.GetHash()));
+    nObjectsMemoryUsage += vote.DynamicMemoryUsage();
+}
+
+void CInstantSend::RemoveTxLockVote(const uint256& nVoteHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    txlockvote_map_t::iterator it = mapTxLockVotes.find(nVoteHash);
+    if(it != mapTxLockVotes.end()) {
+        std::unordered_map<uint256, std::set<uint256>, SaltedTxidHasher>::iterator itTxVotes = mapTxLockVoteHashes.find(it->second.GetTxHash());
+        if(itTxVotes != mapTxLockVoteHashes.end()) {
+            nObjectsMemoryUsage -= memusage::DynamicUsage(itTxVotes->second);
+            itTxVotes->second.erase(nVoteHash);
+            if(itTxVotes->second.empty()) {
+                mapTxLockVoteHashes.erase(itTxVotes);
+            } else {
+                nObjectsMemoryUsage += memusage::DynamicUsage(itTxVotes->second);
+            }
+        }
+        nObjectsMemoryUsage -= it->second.DynamicMemoryUsage();
+        mapTxLockVotes.erase(it);
+    }
+    it = mapTxLockVotesOrphan.find(nVoteHash);
+    if(it != mapTxLockVotesOrphan.end()) {
+        nObjectsMemoryUsage -= it->second.DynamicMemoryUsage();
+        mapTxLockVotesOrphan.erase(it);
+    }
+}
+
+size_t CInstantSend::AddVotedOutpoint(const COutPoint& outpoint, const uint256& txHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::set<uint256>& setHashes = mapVotedOutpoints[outpoint];
+    nObjectsMemoryUsage -= memusage::DynamicUsage(setHashes);
+    setHashes.insert(txHash);
+    nObjectsMemoryUsage += memusage::DynamicUsage(setHashes);
+    return setHashes.size();
+}
+
+void CInstantSend::RemoveVotedOutpoint(const COutPoint& outpoint, const uint256& txHash)
+{
+    AssertLockHeld(cs_instantsend);
+
+    std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher>::iterator it = mapVotedOutpoints.find(outpoint);
+    if(it == mapVotedOutpoints.end()) return;
+    nObjectsMemoryUsage -= memusage::DynamicUsage(it->second);
+    it->second.erase(txHash);
+    if(it->second.empty()) {
+        mapVotedOutpoints.erase(it);
+    } else {
+        nObjectsMemoryUsage += memusage::DynamicUsage(it->second);
+    }
 }
 
 void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
@@ -183,11 +337,13 @@ void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
     AssertLockHeld(cs_main);
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate == mapTxLockCandidates.end()) return;
     Vote(itLockCandidate->second, connman);
     // Let's see if our vote changed smth
     TryToFinalizeLockCandidate(itLockCandidate->second);
+
+    LimitMemoryUsage();
 }
 
 void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
@@ -229,14 +385,14 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, nRank);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher>::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
 
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                txlockcandidate_map_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasMasternodeVoted(itOutpointLock->first, activeMasternode.outpoint)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -266,22 +422,17 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        AddTxLockVote(vote);
+        size_t nUsageBefore = itOutpointLock->second.DynamicMemoryUsage();
         if(itOutpointLock->second.AddVote(vote)) {
+            nObjectsMemoryUsage += itOutpointLock->second.DynamicMemoryUsage() - nUsageBefore;
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
 
-            if(itVoted == mapVotedOutpoints.end()) {
-                std::set<uint256> setHashes;
-                setHashes.insert(txHash);
-                mapVotedOutpoints.insert(std::make_pair(itOutpointLock->first, setHashes));
-            } else {
-                mapVotedOutpoints[itOutpointLock->first].insert(txHash);
-                if(mapVotedOutpoints[itOutpointLock->first].size() > 1) {
-                    // it's ok to continue, just warn user
-                    LogPrintf("CInstantSend::Vote -- WARNING: Vote conflicts with some existing votes: txHash=%s, outpoint=%s, vote=%s\n",
-                            txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
-                }
+            if(AddVotedOutpoint(itOutpointLock->first, txHash) > 1) {
+                // it's ok to continue, just warn user
+                LogPrintf("CInstantSend::Vote -- WARNING: Vote conflicts with some existing votes: txHash=%s, outpoint=%s, vote=%s\n",
+                        txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
             }
 
             vote.Relay(connman);
@@ -292,6 +443,69 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 }
 
 //received a consensus vote
+void CInstantSend::ProcessPendingTxLockVotes(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CTxLockVote> > vecVotes;
+    {
+        boost::unique_lock<boost::mutex> lock(csPendingTxLockVotes);
+        while(vecPendingTxLockVotes.empty())
+            condPendingTxLockVotes.wait(lock);
+        vecVotes.swap(vecPendingTxLockVotes);
+        mapPendingTxLockVotesCount.clear();
+        nPendingTxLockVotesMemoryUsage = 0;
+    }
+
+    // Check masternodes and their ranks first, there is no need
+    // to verify signatures of votes which fail these anyway
+    std::vector<std::pair<NodeId, CTxLockVote> > vecCandidateVotes;
+    std::vector<CHashSignature> vecSignatures;
+    std::set<uint256> setVoteHashes;
+    for(size_t i = 0; i < vecVotes.size(); i++) {
+        const CTxLockVote& vote = vecVotes[i].second;
+        // the same vote could have been received from several peers meanwhile
+        if(!setVoteHashes.insert(vote.GetHash()).second) continue;
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(vote.GetHash())) continue;
+            if(filterRejectedTxLockVotes.contains(vote.GetHash())) continue;
+        }
+        CHashSignature sig;
+        if(!vote.IsMasternodeValid(NULL, connman) || !vote.GetSignatureCheck(sig)) {
+            LogPrint("instantsend", "CInstantSend::ProcessPendingTxLockVotes -- Vote is invalid, txid=%s\n", vote.GetTxHash().ToString());
+            LOCK(cs_instantsend);
+            filterRejectedTxLockVotes.insert(vote.GetHash());
+            continue;
+        }
+        vecCandidateVotes.push_back(vecVotes[i]);
+        vecSignatures.push_back(sig);
+    }
+
+    // Verify all signatures at once on the message signature check threads
+    CHashSigner::VerifyHashes(vecSignatures);
+
+    LOCK(cs_main);
+#ifdef ENABLE_WALLET
+    if (pwalletMain)
+        LOCK(pwalletMain->cs_wallet);
+#endif
+    LOCK(cs_instantsend);
+
+    for(size_t i = 0; i < vecCandidateVotes.size(); i++) {
+        CTxLockVote& vote = vecCandidateVotes[i].second;
+        if(!vecSignatures[i].fValid) {
+            LogPrintf("CInstantSend::ProcessPendingTxLockVotes -- Signature invalid, vote hash=%s, peer=%d\n", vote.GetHash().ToString(), vecCandidateVotes[i].first);
+            filterRejectedTxLockVotes.insert(vote.GetHash());
+            // apply node's ban score
+            Misbehaving(vecCandidateVotes[i].first, 20);
+            continue;
+        }
+        if(mapTxLockVotes.count(vote.GetHash())) continue;
+        ProcessVerifiedTxLockVote(vote, connman);
+    }
+
+    LimitMemoryUsage();
+}
+
 bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman& connman)
 {
     // cs_main, cs_wallet and cs_instantsend should be already locked
@@ -302,30 +516,46 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 #endif
     AssertLockHeld(cs_instantsend);
 
-    uint256 txHash = vote.GetTxHash();
-
     if(!vote.IsValid(pfrom, connman)) {
         // could be because of missing MN
-        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", txHash.ToString());
+        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", vote.GetTxHash().ToString());
         return false;
     }
 
+    return ProcessVerifiedTxLockVote(vote, connman);
+}
+
+bool CInstantSend::ProcessVerifiedTxLockVote(CTxLockVote& vote, CConnman& connman)
+{
+    // cs_main, cs_wallet and cs_instantsend should be already locked
+    AssertLockHeld(cs_main);
+#ifdef ENABLE_WALLET
+    if (pwalletMain)
+        AssertLockHeld(pwalletMain->cs_wallet);
+#endif
+    AssertLockHeld(cs_instantsend);
+
+    uint256 txHash = vote.GetTxHash();
+
+    // store valid vote, orphan votes being reprocessed are stored already
+    AddTxLockVote(vote);
+
     // relay valid vote asap
     vote.Relay(connman);
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
             // start timeout countdown after the very first vote
             CreateEmptyTxLockCandidate(txHash);
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            AddTxLockVoteOrphan(vote);
             LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
-            std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+            txlockrequest_map_t::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
             if(itLockRequest == mapLockRequestAccepted.end()) {
                 itLockRequest = mapLockRequestRejected.find(txHash);
                 if(itLockRequest == mapLockRequestRejected.end()) {
@@ -375,14 +605,14 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 
     LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
 
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher>::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
     if(it1 != mapVotedOutpoints.end()) {
         BOOST_FOREACH(const uint256& hash, it1->second) {
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // let's see if it was the same masternode who voted on this outpoint
                 // for another tx lock request
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                txlockcandidate_map_t::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2 !=mapTxLockCandidates.end() && it2->second.HasMasternodeVoted(vote.GetOutpoint(), vote.GetMasternodeOutpoint())) {
                     // yes, it was the same masternode
                     LogPrintf("CInstantSend::ProcessTxLockVote -- masternode sent conflicting votes! %s\n", vote.GetMasternodeOutpoint().ToStringShort());
@@ -399,18 +629,16 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
                 }
             }
         }
-        // store all votes, regardless of them being sent by malicious masternode or not
-        it1->second.insert(txHash);
-    } else {
-        std::set<uint256> setHashes;
-        setHashes.insert(txHash);
-        mapVotedOutpoints.insert(std::make_pair(vote.GetOutpoint(), setHashes));
     }
+    // store all votes, regardless of them being sent by malicious masternode or not
+    AddVotedOutpoint(vote.GetOutpoint(), txHash);
 
+    size_t nUsageBefore = txLockCandidate.DynamicMemoryUsage();
     if(!txLockCandidate.AddVote(vote)) {
         // this should never happen
         return false;
     }
+    nObjectsMemoryUsage += txLockCandidate.DynamicMemoryUsage() - nUsageBefore;
 
     int nSignatures = txLockCandidate.CountVotes();
     int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
@@ -431,13 +659,23 @@ void CInstantSend::ProcessOrphanTxLockVotes(CConnman& connman)
 #endif
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second, connman)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
-        }
+    // Processing a vote can complete a lock and remove candidates together with
+    // their orphan votes, so look each of them up again instead of iterating the map
+    std::vector<uint256> vecOrphanVoteHashes;
+    vecOrphanVoteHashes.reserve(mapTxLockVotesOrphan.size());
+    for(txlockvote_map_t::iterator it = mapTxLockVotesOrphan.begin(); it != mapTxLockVotesOrphan.end(); ++it) {
+        vecOrphanVoteHashes.push_back(it->first);
+    }
+
+    BOOST_FOREACH(const uint256& nVoteHash, vecOrphanVoteHashes) {
+        txlockvote_map_t::iterator it = mapTxLockVotesOrphan.find(nVoteHash);
+        if(it == mapTxLockVotesOrphan.end()) continue;
+        CTxLockVote vote = it->second;
+        if(!ProcessTxLockVote(NULL, vote, connman)) continue;
+        it = mapTxLockVotesOrphan.find(nVoteHash);
+        if(it == mapTxLockVotesOrphan.end()) continue;
+        nObjectsMemoryUsage -= it->second.DynamicMemoryUsage();
+        mapTxLockVotesOrphan.erase(it);
     }
 }
 
@@ -459,7 +697,7 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    txlockvote_map_t::iterator it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
         if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
             nCountVotes++;
@@ -547,7 +785,7 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher>::iterator it = mapLockedOutpoints.find(outpoint);
     if(it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
@@ -569,8 +807,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            txlockcandidate_map_t::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 LogPrintf("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -581,12 +819,12 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
                     txHash.ToString(), hashConflicting.ToString());
             CTxLockRequest txLockRequest = itLockCandidate->second.txLockRequest;
             CTxLockRequest txLockRequestConflicting = itLockCandidateConflicting->second.txLockRequest;
-            itLockCandidate->second.SetConfirmedHeight(0); // expired
-            itLockCandidateConflicting->second.SetConfirmedHeight(0); // expired
-            CheckAndRemove(); // clean up
+            // clean up
+            RemoveTxLockCandidate(itLockCandidate);
+            RemoveTxLockCandidate(itLockCandidateConflicting);
             // AlreadyHave should still return "true" for both of them
-            mapLockRequestRejected.insert(make_pair(txHash, txLockRequest));
-            mapLockRequestRejected.insert(make_pair(hashConflicting, txLockRequestConflicting));
+            AddLockRequest(mapLockRequestRejected, txLockRequest);
+            AddLockRequest(mapLockRequestRejected, txLockRequestConflicting);
 
             // TODO: clean up mapLockRequestRejected later somehow
             //       (not a big issue since we already PoSe ban malicious masternodes
@@ -651,63 +889,49 @@ void CInstantSend::CheckAndRemove()
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
-
-    // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
-        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-        if(txLockCandidate.IsExpired(nCachedBlockHeight)) {
-            LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
-            std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
-            while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
-                mapLockedOutpoints.erase(itOutpointLock->first);
-                mapVotedOutpoints.erase(itOutpointLock->first);
-                ++itOutpointLock;
-            }
-            mapLockRequestAccepted.erase(txHash);
-            mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
-        }
-    }
-
-    // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(nCachedBlockHeight)) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
-                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+    int nKeepLock = Params().GetConsensus().nInstantSendKeepLock;
+    int64_t nNow = GetTime();
+
+    // remove expired candidates, their votes are removed together with them
+    std::set<std::pair<int, uint256> >::iterator itConfirmed = setTxLockCandidatesConfirmed.begin();
+    while(itConfirmed != setTxLockCandidatesConfirmed.end() && nCachedBlockHeight - itConfirmed->first > nKeepLock) {
+        txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(itConfirmed->second);
+        // the candidate could have been reorged out or confirmed at another height since this entry was added
+        if(itLockCandidate != mapTxLockCandidates.end() && itLockCandidate->second.IsExpired(nCachedBlockHeight)) {
+            LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", itConfirmed->second.ToString());
+            RemoveTxLockCandidate(itLockCandidate);
         }
+        setTxLockCandidatesConfirmed.erase(itConfirmed++);
     }
 
     // remove timed out orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.IsTimedOut()) {
+    while(!queueTxLockVotesOrphan.empty() && nNow - queueTxLockVotesOrphan.front().first > INSTANTSEND_LOCK_TIMEOUT_SECONDS) {
+        txlockvote_map_t::iterator itOrphanVote = mapTxLockVotesOrphan.find(queueTxLockVotesOrphan.front().second);
+        if(itOrphanVote != mapTxLockVotesOrphan.end() && itOrphanVote->second.IsTimedOut()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
                     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+            RemoveTxLockVote(itOrphanVote->first);
         }
+        queueTxLockVotesOrphan.pop_front();
     }
 
-    // remove invalid votes and votes for failed lock attempts
-    itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsFailed()) {
+    // remove invalid votes and votes for failed lock attempts,
+    // votes for completed locks are kept until the lock expires
+    while(!queueTxLockVotes.empty() && nNow - queueTxLockVotes.front().first > INSTANTSEND_FAILED_TIMEOUT_SECONDS) {
+        txlockvote_map_t::iterator itVote = mapTxLockVotes.find(queueTxLockVotes.front().second);
+        if(itVote != mapTxLockVotes.end() && itVote->second.IsFailed()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
                     itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+            RemoveTxLockVote(itVote->first);
         }
+        queueTxLockVotes.pop_front();
+    }
+
+    // drop candidates which are gone or completed from the front of the eviction queue
+    while(!queueTxLockCandidates.empty()) {
+        txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(queueTxLockCandidates.front().second);
+        if(itLockCandidate != mapTxLockCandidates.end() && !itLockCandidate->second.IsAllOutPointsReady()) break;
+        queueTxLockCandidates.pop_front();
     }
 
     // remove timed out masternode orphan votes (DOS protection)
@@ -721,27 +945,121 @@ void CInstantSend::CheckAndRemove()
             ++itMasternodeOrphan;
         }
     }
+
+    LimitMemoryUsage();
+
     LogPrintf("CInstantSend::CheckAndRemove -- %s\n", ToString());
 }
 
+void CInstantSend::LimitMemoryUsage()
+{
+    AssertLockHeld(cs_instantsend);
+
+    if(DynamicMemoryUsage() <= nMaxMemoryUsage) return;
+
+    // Evict the data we are the least likely to need first: orphan votes,
+    // then lock candidates which did not complete (together with their votes),
+    // then votes we only keep to answer getdata requests for them.
+    // Completed locks are never evicted, they only go away once they expire.
+    int nEvicted = 0;
+
+    while(DynamicMemoryUsage() > nMaxMemoryUsage && !queueTxLockVotesOrphan.empty()) {
+        uint256 nVoteHash = queueTxLockVotesOrphan.front().second;
+        queueTxLockVotesOrphan.pop_front();
+        if(!mapTxLockVotesOrphan.count(nVoteHash)) continue;
+        RemoveTxLockVote(nVoteHash);
+        nEvicted++;
+    }
+
+    while(DynamicMemoryUsage() > nMaxMemoryUsage && !queueTxLockCandidates.empty()) {
+        txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(queueTxLockCandidates.front().second);
+        queueTxLockCandidates.pop_front();
+        if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidate->second.IsAllOutPointsReady()) continue;
+        RemoveTxLockCandidate(itLockCandidate);
+        nEvicted++;
+    }
+
+    while(DynamicMemoryUsage() > nMaxMemoryUsage && !queueTxLockVotes.empty()) {
+        txlockvote_map_t::iterator itVote = mapTxLockVotes.find(queueTxLockVotes.front().second);
+        queueTxLockVotes.pop_front();
+        if(itVote == mapTxLockVotes.end()) continue;
+        txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(itVote->second.GetTxHash());
+        if(itLockCandidate != mapTxLockCandidates.end() && itLockCandidate->second.IsAllOutPointsReady()) continue;
+        RemoveTxLockVote(itVote->first);
+        nEvicted++;
+    }
+
+    LogPrint("instantsend", "CInstantSend::LimitMemoryUsage -- evicted %d entries, memory usage: %llu, limit: %llu\n",
+            nEvicted, DynamicMemoryUsage(), nMaxMemoryUsage);
+}
+
+void CInstantSend::SetMaxMemoryUsage(size_t nMaxMemoryUsageIn)
+{
+    LOCK(cs_instantsend);
+    nMaxMemoryUsage = nMaxMemoryUsageIn;
+}
+
+size_t CInstantSend::DynamicMemoryUsage()
+{
+    LOCK(cs_instantsend);
+    return memusage::DynamicUsage(mapLockRequestAccepted) +
+            memusage::DynamicUsage(mapLockRequestRejected) +
+            memusage::DynamicUsage(mapTxLockVotes) +
+            memusage::DynamicUsage(mapTxLockVotesOrphan) +
+            memusage::DynamicUsage(mapTxLockVoteHashes) +
+            memusage::DynamicUsage(mapTxLockCandidates) +
+            memusage::DynamicUsage(mapVotedOutpoints) +
+            memusage::DynamicUsage(mapLockedOutpoints) +
+            memusage::DynamicUsage(mapMasternodeOrphanVotes) +
+            (queueTxLockVotes.size() + queueTxLockVotesOrphan.size() + queueTxLockCandidates.size()) * sizeof(expiry_queue_t::value_type) +
+            memusage::DynamicUsage(setTxLockCandidatesConfirmed) +
+            nObjectsMemoryUsage +
+            PendingTxLockVotesMemoryUsage();
+}
+
+size_t CInstantSend::PendingTxLockVotesMemoryUsage()
+{
+    boost::unique_lock<boost::mutex> lock(csPendingTxLockVotes);
+    return memusage::DynamicUsage(vecPendingTxLockVotes) +
+            memusage::DynamicUsage(mapPendingTxLockVotesCount) +
+            nPendingTxLockVotesMemoryUsage;
+}
+
+void CInstantSend::CopyStats(CInstantSendStats& statsRet)
+{
+    LOCK(cs_instantsend);
+    statsRet.nLockRequestsAccepted = mapLockRequestAccepted.size();
+    statsRet.nLockRequestsRejected = mapLockRequestRejected.size();
+    statsRet.nTxLockVotes = mapTxLockVotes.size();
+    statsRet.nTxLockVotesOrphan = mapTxLockVotesOrphan.size();
+    statsRet.nTxLockCandidates = mapTxLockCandidates.size();
+    statsRet.nVotedOutpoints = mapVotedOutpoints.size();
+    statsRet.nLockedOutpoints = mapLockedOutpoints.size();
+    statsRet.nMemoryUsage = DynamicMemoryUsage();
+    statsRet.nMaxMemoryUsage = nMaxMemoryUsage;
+}
+
 bool CInstantSend::AlreadyHave(const uint256& hash)
 {
     LOCK(cs_instantsend);
     return mapLockRequestAccepted.count(hash) ||
             mapLockRequestRejected.count(hash) ||
-            mapTxLockVotes.count(hash);
+            mapTxLockVotes.count(hash) ||
+            filterRejectedTxLockVotes.contains(hash);
 }
 
 void CInstantSend::AcceptLockRequest(const CTxLockRequest& txLockRequest)
 {
     LOCK(cs_instantsend);
-    mapLockRequestAccepted.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+    AddLockRequest(mapLockRequestAccepted, txLockRequest);
+    LimitMemoryUsage();
 }
 
 void CInstantSend::RejectLockRequest(const CTxLockRequest& txLockRequest)
 {
     LOCK(cs_instantsend);
-    mapLockRequestRejected.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+    AddLockRequest(mapLockRequestRejected, txLockRequest);
+    LimitMemoryUsage();
 }
 
 bool CInstantSend::HasTxLockRequest(const uint256& txHash)
@@ -754,7 +1072,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) return false;
     txLockRequestRet = it->second.txLockRequest;
 
@@ -765,7 +1083,7 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    txlockvote_map_t::iterator it = mapTxLockVotes.find(hash);
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
@@ -780,7 +1098,7 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
     LOCK(cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator it = mapTxLockCandidates.find(txHash);
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
@@ -792,7 +1110,7 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     LOCK(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -817,7 +1135,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -836,7 +1154,7 @@ bool CInstantSend::IsTxLockCandidateTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.IsTimedOut();
@@ -849,7 +1167,7 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay(connman);
     }
@@ -888,18 +1206,21 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    txlockcandidate_map_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
                 txHash.ToString(), nHeightNew);
         itLockCandidate->second.SetConfirmedHeight(nHeightNew);
+        if(nHeightNew != -1) {
+            setTxLockCandidatesConfirmed.insert(std::make_pair(nHeightNew, txHash));
+        }
         // Loop through outpoint locks
         std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
         while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
             // Check corresponding lock votes
             std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
             std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
+            txlockvote_map_t::iterator it;
             while(itVote != vVotes.end()) {
                 uint256 nVoteHash = itVote->GetHash();
                 LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
@@ -915,12 +1236,15 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
+    txlockvote_map_t::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
     while(itOrphanVote != mapTxLockVotesOrphan.end()) {
         if(itOrphanVote->second.GetTxHash() == txHash) {
             LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
                     txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+            txlockvote_map_t::iterator itVote = mapTxLockVotes.find(itOrphanVote->first);
+            if(itVote != mapTxLockVotes.end()) {
+                itVote->second.SetConfirmedHeight(nHeightNew);
+            }
         }
         ++itOrphanVote;
     }
@@ -929,7 +1253,25 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 std::string CInstantSend::ToString()
 {
     LOCK(cs_instantsend);
-    return strprintf("Lock Candidates: %llu, Votes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size());
+    return strprintf("Lock Candidates: %llu, Votes %llu, Memory usage: %llu", mapTxLockCandidates.size(), mapTxLockVotes.size(), DynamicMemoryUsage());
+}
+
+void ThreadCheckTxLockVotes(CConnman& connman)
+{
+    if(fLiteMode) return; // disable all Sparks specific functionality
+
+    static bool fOneThread;
+    if(fOneThread) return;
+    fOneThread = true;
+
+    // Make this thread recognisable as the InstantSend vote verification thread
+    RenameThread("sparks-is-votes");
+
+    while (true)
+    {
+        // blocks until there are votes to verify
+        instantsend.ProcessPendingTxLockVotes(connman);
+    }
 }
 
 //
@@ -1005,16 +1347,30 @@ int CTxLockRequest::GetMaxSignatures() const
 //
 
 bool CTxLockVote::IsValid(CNode* pnode, CConnman& connman) const
+{
+    if(!IsMasternodeValid(pnode, connman)) {
+        return false;
+    }
+
+    if(!CheckSignature()) {
+        LogPrintf("CTxLockVote::IsValid -- Signature invalid\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool CTxLockVote::IsMasternodeValid(CNode* pnode, CConnman& connman) const
 {
     if(!mnodeman.Has(outpointMasternode)) {
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Unknown masternode %s\n", outpointMasternode.ToStringShort());
+        LogPrint("instantsend", "CTxLockVote::IsMasternodeValid -- Unknown masternode %s\n", outpointMasternode.ToStringShort());
         mnodeman.AskForMN(pnode, outpointMasternode, connman);
         return false;
     }
 
     Coin coin;
     if(!GetUTXOCoin(outpoint, coin)) {
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Failed to find UTXO %s\n", outpoint.ToStringShort());
+        LogPrint("instantsend", "CTxLockVote::IsMasternodeValid -- Failed to find UTXO %s\n", outpoint.ToStringShort());
         return false;
     }
 
@@ -1023,23 +1379,18 @@ bool CTxLockVote::IsValid(CNode* pnode, CConnman& connman) const
     int nRank;
     if(!mnodeman.GetMasternodeRank(outpointMasternode, nRank, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION)) {
         //can be caused by past versions trying to vote with an invalid protocol
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Can't calculate rank for masternode %s\n", outpointMasternode.ToStringShort());
+        LogPrint("instantsend", "CTxLockVote::IsMasternodeValid -- Can't calculate rank for masternode %s\n", outpointMasternode.ToStringShort());
         return false;
     }
-    LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s, rank=%d\n", outpointMasternode.ToStringShort(), nRank);
+    LogPrint("instantsend", "CTxLockVote::IsMasternodeValid -- Masternode %s, rank=%d\n", outpointMasternode.ToStringShort(), nRank);
 
     int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
     if(nRank > nSignaturesTotal) {
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s is not in the top %d (%d), vote hash=%s\n",
+        LogPrint("instantsend", "CTxLockVote::IsMasternodeValid -- Masternode %s is not in the top %d (%d), vote hash=%s\n",
                 outpointMasternode.ToStringShort(), nSignaturesTotal, nRank, GetHash().ToString());
         return false;
     }
 
-    if(!CheckSignature()) {
-        LogPrintf("CTxLockVote::IsValid -- Signature invalid\n");
-        return false;
-    }
-
     return true;
 }
 
@@ -1052,10 +1403,26 @@ uint256 CTxLockVote::GetHash() const
     return ss.GetHash();
 }
 
+std::string CTxLockVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + outpoint.ToStringShort();
+}
+
+bool CTxLockVote::GetSignatureCheck(CHashSignature& sigRet) const
+{
+    masternode_info_t infoMn;
+    if(!mnodeman.GetMasternodeInfo(outpointMasternode, infoMn)) {
+        return false;
+    }
+
+    sigRet = CHashSignature(CMessageSigner::GetMessageHash(GetSignatureMessage()), infoMn.pubKeyMasternode, vchMasternodeSignature);
+    return true;
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     masternode_info_t infoMn;
 
@@ -1075,7 +1442,7 @@ bool CTxLockVote::CheckSignature() const
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchMasternodeSignature, activeMasternode.keyMasternode)) {
         LogPrintf("CTxLockVote::Sign -- SignMessage() failed\n");
@@ -1096,6 +1463,11 @@ void CTxLockVote::Relay(CConnman& connman) const
     connman.RelayInv(inv);
 }
 
+size_t CTxLockVote::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(vchMasternodeSignature);
+}
+
 bool CTxLockVote::IsExpired(int nHeight) const
 {
     // Locks and votes expire nInstantSendKeepLock blocks after the block corresponding tx was included into.
@@ -1149,6 +1521,17 @@ void COutPointLock::Relay(CConnman& connman) const
     }
 }
 
+size_t COutPointLock::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapMasternodeVotes);
+    std::map<COutPoint, CTxLockVote>::const_iterator itVote = mapMasternodeVotes.begin();
+    while(itVote != mapMasternodeVotes.end()) {
+        nUsage += itVote->second.DynamicMemoryUsage();
+        ++itVote;
+    }
+    return nUsage;
+}
+
 //
 // CTxLockCandidate
 //
@@ -1222,3 +1605,14 @@ void CTxLockCandidate::Relay(CConnman& connman) const
         ++itOutpointLock;
     }
 }
+
+size_t CTxLockCandidate::DynamicMemoryUsage() const
+{
+    size_t nUsage = RecursiveDynamicUsage(txLockRequest) + memusage::DynamicUsage(mapOutPointLocks);
+    std::map<COutPoint, COutPointLock>::const_iterator itOutpointLock = mapOutPointLocks.begin();
+    while(itOutpointLock != mapOutPointLocks.end()) {
+        nUsage += itOutpointLock->second.DynamicMemoryUsage();
+        ++itOutpointLock;
+    }
+    return nUsage;
+}
@@ -4,15 +4,22 @@
 #ifndef INSTANTX_H
 #define INSTANTX_H
 
+#include "bloom.h"
 #include "chain.h"
 #include "net.h"
 #include "primitives/transaction.h"
+#include "sync.h"
+#include "txmempool.h"
+
+#include <deque>
+#include <unordered_map>
 
 class CTxLockVote;
 class COutPointLock;
 class CTxLockRequest;
 class CTxLockCandidate;
 class CInstantSend;
+struct CHashSignature;
 
 extern CInstantSend instantsend;
 
@@ -36,37 +43,102 @@ static const int INSTANTSEND_LOCK_TIMEOUT_SECONDS   = 15;
 // For how long we are going to keep invalid votes and votes for failed lock attempts,
 // must be greater than INSTANTSEND_LOCK_TIMEOUT_SECONDS
 static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
+// Keep InstantSend lock data below this many megabytes by default
+static const unsigned int DEFAULT_MAX_INSTANTSEND_SIZE = 32;
+// How many votes of a single peer can wait for verification at a time
+static const int MAX_PENDING_TXLOCKVOTES_PER_PEER   = 1000;
+// How many hashes of rejected votes to remember
+static const unsigned int REJECTED_TXLOCKVOTES_SIZE = 50000;
 
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+struct CInstantSendStats
+{
+    size_t nLockRequestsAccepted;
+    size_t nLockRequestsRejected;
+    size_t nTxLockVotes;
+    size_t nTxLockVotesOrphan;
+    size_t nTxLockCandidates;
+    size_t nVotedOutpoints;
+    size_t nLockedOutpoints;
+    size_t nMemoryUsage;
+    size_t nMaxMemoryUsage;
+};
+
 class CInstantSend
 {
 private:
+    typedef std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> txlockrequest_map_t;
+    typedef std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> txlockvote_map_t;
+    typedef std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher> txlockcandidate_map_t;
+    typedef std::deque<std::pair<int64_t, uint256> > expiry_queue_t;
+
     // Keep track of current block height
     int nCachedBlockHeight;
 
     // maps for AlreadyHave
-    std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
-    std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    txlockrequest_map_t mapLockRequestAccepted; // tx hash - tx
+    txlockrequest_map_t mapLockRequestRejected; // tx hash - tx
+    txlockvote_map_t mapTxLockVotes; // vote hash - vote
+    txlockvote_map_t mapTxLockVotesOrphan; // vote hash - vote
+    std::unordered_map<uint256, std::set<uint256>, SaltedTxidHasher> mapTxLockVoteHashes; // tx hash - vote hash set
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    txlockcandidate_map_t mapTxLockCandidates; // tx hash - lock candidate
 
-    std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher> mapVotedOutpoints; // utxo - tx hash set
+    std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> mapLockedOutpoints; // utxo - tx hash
 
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
 
+    // Expiry queues, oldest first, so that CheckAndRemove and LimitMemoryUsage
+    // only need to look at the entries which could actually be removed.
+    // Entries are not removed from these when the object they point to goes away,
+    // stale entries are simply skipped once they reach the front.
+    expiry_queue_t queueTxLockVotes; // time added - vote hash
+    expiry_queue_t queueTxLockVotesOrphan; // time added - vote hash
+    expiry_queue_t queueTxLockCandidates; // time added - tx hash
+    std::set<std::pair<int, uint256> > setTxLockCandidatesConfirmed; // confirmed height - tx hash
+
+    // memory used by the objects stored in the maps above,
+    // the maps themselves are accounted for in DynamicMemoryUsage
+    size_t nObjectsMemoryUsage;
+    size_t nMaxMemoryUsage;
+
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
+    void RemoveTxLockCandidate(txlockcandidate_map_t::iterator itLockCandidate);
     void Vote(CTxLockCandidate& txLockCandidate, CConnman& connman);
 
+    bool AddLockRequest(txlockrequest_map_t& mapLockRequests, const CTxLockRequest& txLockRequest);
+    bool AddTxLockVote(const CTxLockVote& vote);
+    void AddTxLockVoteOrphan(const CTxLockVote& vote);
+    void RemoveTxLockVote(const uint256& nVoteHash);
+    size_t AddVotedOutpoint(const COutPoint& outpoint, const uint256& txHash);
+    void RemoveVotedOutpoint(const COutPoint& outpoint, const uint256& txHash);
+
+    // evict data until we are below nMaxMemoryUsage again
+    void LimitMemoryUsage();
+    // memory used by the votes waiting for verification, they can't be evicted
+    size_t PendingTxLockVotesMemoryUsage();
+
+    // votes which failed the masternode or signature checks, so that
+    // the same invalid vote isn't requested and verified over and over
+    CRollingBloomFilter filterRejectedTxLockVotes; // vote hash
+
+    // votes waiting for ThreadCheckTxLockVotes to verify them
+    CWaitableCriticalSection csPendingTxLockVotes;
+    CConditionVariable condPendingTxLockVotes;
+    std::vector<std::pair<NodeId, CTxLockVote> > vecPendingTxLockVotes; // sender - vote
+    std::map<NodeId, int> mapPendingTxLockVotesCount; // sender - number of pending votes
+    size_t nPendingTxLockVotesMemoryUsage;
+
     //process consensus vote message
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman& connman);
+    //same as above for votes with already verified rank and signature
+    bool ProcessVerifiedTxLockVote(CTxLockVote& vote, CConnman& connman);
     void ProcessOrphanTxLockVotes(CConnman& connman);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
@@ -83,11 +155,22 @@ private:
 public:
     CCriticalSection cs_instantsend;
 
+    CInstantSend() :
+        nCachedBlockHeight(0),
+        nObjectsMemoryUsage(0),
+        nMaxMemoryUsage(DEFAULT_MAX_INSTANTSEND_SIZE * 1000000),
+        filterRejectedTxLockVotes(REJECTED_TXLOCKVOTES_SIZE, 0.000001),
+        nPendingTxLockVotesMemoryUsage(0)
+        {}
+
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CConnman& connman);
     void Vote(const uint256& txHash, CConnman& connman);
 
+    // wait for queued votes, verify them in parallel and process the valid ones
+    void ProcessPendingTxLockVotes(CConnman& connman);
+
     bool AlreadyHave(const uint256& hash);
 
     void AcceptLockRequest(const CTxLockRequest& txLockRequest);
@@ -108,6 +191,9 @@ public:
 
     // remove expired entries from maps
     void CheckAndRemove();
+    void SetMaxMemoryUsage(size_t nMaxMemoryUsageIn);
+    size_t DynamicMemoryUsage();
+    void CopyStats(CInstantSendStats& statsRet);
     // verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
@@ -151,6 +237,8 @@ private:
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
     int64_t nTimeCreated;
 
+    std::string GetSignatureMessage() const;
+
 public:
     CTxLockVote() :
         txHash(),
@@ -187,6 +275,8 @@ public:
     COutPoint GetMasternodeOutpoint() const { return outpointMasternode; }
 
     bool IsValid(CNode* pnode, CConnman& connman) const;
+    // same as IsValid but doesn't check the signature
+    bool IsMasternodeValid(CNode* pnode, CConnman& connman) const;
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
     bool IsTimedOut() const;
@@ -194,8 +284,11 @@ public:
 
     bool Sign();
     bool CheckSignature() const;
+    bool GetSignatureCheck(CHashSignature& sigRet) const;
 
     void Relay(CConnman& connman) const;
+
+    size_t DynamicMemoryUsage() const;
 };
 
 class COutPointLock
@@ -224,6 +317,8 @@ public:
     void MarkAsAttacked() { fAttacked = true; }
 
     void Relay(CConnman& connman) const;
+
+    size_t DynamicMemoryUsage() const;
 };
 
 class CTxLockCandidate
@@ -258,6 +353,10 @@ public:
     bool IsTimedOut() const;
 
     void Relay(CConnman& connman) const;
+
+    size_t DynamicMemoryUsage() const;
 };
 
+void ThreadCheckTxLockVotes(CConnman& connman);
+
 #endif
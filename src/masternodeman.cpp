@@ -21,15 +21,6 @@ CMasternodeMan mnodeman;
 
 const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-7";
 
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CMasternode*>& t1,
-                    const std::pair<int, CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
-
 struct CompareScoreMN
 {
     bool operator()(const std::pair<arith_uint256, CMasternode*>& t1,
@@ -63,6 +54,13 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  setLastPaid(),
+  mapMasternodesByPayee(),
+  mapPayeeLastPaid(),
+  pindexLastPaidScanned(NULL),
+  mapLastPaidRescanVotes(),
+  mapScoresCache(),
+  nScoresCacheCounter(0),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -75,7 +73,18 @@ bool CMasternodeMan::Add(CMasternode &mn)
     if (Has(mn.vin.prevout)) return false;
 
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
-    mapMasternodes[mn.vin.prevout] = mn;
+    CMasternode& mnNew = mapMasternodes[mn.vin.prevout];
+    mnNew = mn;
+    CScript payee = GetScriptForDestination(mnNew.pubKeyCollateralAddress.GetID());
+    mapMasternodesByPayee[payee].insert(mnNew.vin.prevout);
+    // maybe we've already seen it being paid
+    std::map<CScript, std::pair<int, int64_t> >::const_iterator itPaid = mapPayeeLastPaid.find(payee);
+    if (itPaid != mapPayeeLastPaid.end() && itPaid->second.first > mnNew.nBlockLastPaid) {
+        mnNew.nBlockLastPaid = itPaid->second.first;
+        mnNew.nTimeLastPaid = itPaid->second.second;
+    }
+    setLastPaid.insert(std::make_pair(mnNew.nBlockLastPaid, mnNew.vin.prevout));
+    InvalidateScoresCache();
     fMasternodesAdded = true;
     return true;
 }
@@ -189,7 +198,10 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                setLastPaid.erase(std::make_pair(it->second.nBlockLastPaid, it->first));
+                RemovePayeeIndex(it->second);
                 mapMasternodes.erase(it++);
+                InvalidateScoresCache();
                 fMasternodesRemoved = true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
@@ -345,6 +357,12 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    setLastPaid.clear();
+    mapMasternodesByPayee.clear();
+    mapPayeeLastPaid.clear();
+    pindexLastPaidScanned = NULL;
+    mapLastPaidRescanVotes.clear();
+    InvalidateScoresCache();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -524,41 +542,8 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
         }
     }
 
-    std::vector<std::pair<int, CMasternode*> > vecMasternodeLastPaid;
-
-    /*
-        Make a vector with all of the last paid times
-    */
-
     int nMnCount = CountMasternodes();
 
-    for (auto& mnpair : mapMasternodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
-
-        //check protocol version
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
-
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
-
-        //it's too new, wait for a cycle
-        if(fFilterSigTime && mnpair.second.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
-
-        //make sure it has at least as many confirmations as there are masternodes
-        if(GetUTXOConfirmations(mnpair.first) < nMnCount) continue;
-
-        vecMasternodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
-    }
-
-    nCountRet = (int)vecMasternodeLastPaid.size();
-
-    //when the network is in the process of upgrading, don't penalize nodes that recently restarted
-    if(fFilterSigTime && nCountRet < nMnCount/3)
-        return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
-
-    // Sort them low to high
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
-
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
         LogPrintf("CMasternode::GetNextMasternodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight - 101);
@@ -569,25 +554,105 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
     //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
     //  -- (chance per block * chances before IsScheduled will fire)
+    // setLastPaid is already sorted low to high (by last paid block, then by outpoint), so walk it
+    // and stop as soon as the tenth was scored and we know whether the sigTime fallback below applies.
     int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
     arith_uint256 nHighest = 0;
     CMasternode *pBestMasternode = NULL;
-    BOOST_FOREACH (PAIRTYPE(int, CMasternode*)& s, vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
+    for (const auto& lastPaidPair : setLastPaid) {
+        if (nCountTenth >= std::max(nTenthNetwork, 1) && (!fFilterSigTime || nCountRet >= nMnCount/3)) break;
+
+        CMasternode* pmn = Find(lastPaidPair.second);
+        if (!pmn || !IsQualifiedForPayment(*pmn, nBlockHeight, fFilterSigTime, nMnCount)) continue;
+        nCountRet++;
+
+        if (nCountTenth >= std::max(nTenthNetwork, 1)) continue;
+        arith_uint256 nScore = pmn->CalculateScore(blockHash);
         if(nScore > nHighest){
             nHighest = nScore;
-            pBestMasternode = s.second;
+            pBestMasternode = pmn;
         }
         nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
     }
+
+    //when the network is in the process of upgrading, don't penalize nodes that recently restarted
+    if(fFilterSigTime && nCountRet < nMnCount/3)
+        return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
+
     if (pBestMasternode) {
         mnInfoRet = pBestMasternode->GetInfo();
     }
     return mnInfoRet.fInfoValid;
 }
 
+bool CMasternodeMan::IsQualifiedForPayment(CMasternode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount)
+{
+    if(!mn.IsValidForPayment()) return false;
+
+    //check protocol version
+    if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) return false;
+
+    //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
+    if(mnpayments.IsScheduled(mn, nBlockHeight)) return false;
+
+    //it's too new, wait for a cycle
+    if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) return false;
+
+    //make sure it has at least as many confirmations as there are masternodes
+    if(GetUTXOConfirmations(mn.vin.prevout) < nMnCount) return false;
+
+    return true;
+}
+
+int CMasternodeMan::CountQualifiedForPayment()
+{
+    if (!masternodeSync.IsWinnersListSynced())
+        return 0;
+
+    LOCK2(cs_main, cs);
+
+    int nMnCount = CountMasternodes();
+    int nCount = 0;
+    for (auto& mnpair : mapMasternodes) {
+        if (IsQualifiedForPayment(mnpair.second, nCachedBlockHeight, true, nMnCount))
+            nCount++;
+    }
+
+    // same fallback as in GetNextMasternodeInQueueForPayment
+    if (nCount < nMnCount/3) {
+        nCount = 0;
+        for (auto& mnpair : mapMasternodes) {
+            if (IsQualifiedForPayment(mnpair.second, nCachedBlockHeight, false, nMnCount))
+                nCount++;
+        }
+    }
+
+    return nCount;
+}
+
+void CMasternodeMan::RebuildIndexes()
+{
+    AssertLockHeld(cs);
+    setLastPaid.clear();
+    mapMasternodesByPayee.clear();
+    for (const auto& mnpair : mapMasternodes) {
+        setLastPaid.insert(std::make_pair(mnpair.second.nBlockLastPaid, mnpair.first));
+        mapMasternodesByPayee[GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID())].insert(mnpair.first);
+    }
+}
+
+void CMasternodeMan::RemovePayeeIndex(const CMasternode& mn)
+{
+    CScript payee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    std::map<CScript, std::set<COutPoint> >::iterator it = mapMasternodesByPayee.find(payee);
+    if (it == mapMasternodesByPayee.end())
+        return;
+    it->second.erase(mn.vin.prevout);
+    if (it->second.empty())
+        mapMasternodesByPayee.erase(it);
+}
+
 masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion)
 {
     LOCK(cs);
@@ -631,27 +696,51 @@ masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint
     return masternode_info_t();
 }
 
-bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
+const CMasternodeMan::CMasternodeScores* CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, int nMinProtocol)
 {
-    vecMasternodeScoresRet.clear();
-
     if (!masternodeSync.IsMasternodeListSynced())
-        return false;
+        return NULL;
 
     AssertLockHeld(cs);
 
     if (mapMasternodes.empty())
-        return false;
+        return NULL;
+
+    std::pair<uint256, int> key = std::make_pair(nBlockHash, nMinProtocol);
+    std::map<std::pair<uint256, int>, CMasternodeScores>::iterator it = mapScoresCache.find(key);
+    if (it != mapScoresCache.end()) {
+        it->second.nLastUsed = ++nScoresCacheCounter;
+        return it->second.vecScores.empty() ? NULL : &it->second;
+    }
+
+    // evict the least recently used ranking
+    if (mapScoresCache.size() >= MAX_SCORES_CACHE_SIZE) {
+        std::map<std::pair<uint256, int>, CMasternodeScores>::iterator itOldest = mapScoresCache.begin();
+        for (it = mapScoresCache.begin(); it != mapScoresCache.end(); ++it) {
+            if (it->second.nLastUsed < itOldest->second.nLastUsed)
+                itOldest = it;
+        }
+        mapScoresCache.erase(itOldest);
+    }
+
+    CMasternodeScores& scores = mapScoresCache[key];
+    scores.nLastUsed = ++nScoresCacheCounter;
 
     // calculate scores
     for (auto& mnpair : mapMasternodes) {
         if (mnpair.second.nProtocolVersion >= nMinProtocol) {
-            vecMasternodeScoresRet.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+            scores.vecScores.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
         }
     }
 
-    sort(vecMasternodeScoresRet.rbegin(), vecMasternodeScoresRet.rend(), CompareScoreMN());
-    return !vecMasternodeScoresRet.empty();
+    sort(scores.vecScores.rbegin(), scores.vecScores.rend(), CompareScoreMN());
+
+    int nRank = 0;
+    for (auto& scorePair : scores.vecScores) {
+        scores.mapRanks.insert(std::make_pair(scorePair.second->vin.prevout, ++nRank));
+    }
+
+    return scores.vecScores.empty() ? NULL : &scores;
 }
 
 bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
@@ -670,20 +759,16 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    const CMasternodeScores* pscores = GetMasternodeScores(nBlockHash, nMinProtocol);
+    if (!pscores)
         return false;
 
-    int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == outpoint) {
-            nRankRet = nRank;
-            return true;
-        }
-    }
+    std::map<COutPoint, int>::const_iterator it = pscores->mapRanks.find(outpoint);
+    if (it == pscores->mapRanks.end())
+        return false;
 
-    return false;
+    nRankRet = it->second;
+    return true;
 }
 
 bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight, int nMinProtocol)
@@ -702,12 +787,13 @@ bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMast
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    const CMasternodeScores* pscores = GetMasternodeScores(nBlockHash, nMinProtocol);
+    if (!pscores)
         return false;
 
+    vecMasternodeRanksRet.reserve(pscores->vecScores.size());
     int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
+    for (auto& scorePair : pscores->vecScores) {
         nRank++;
         vecMasternodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
     }
@@ -1363,7 +1449,13 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
         }
     } else {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-        if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+        int nProtocolVersionOld = pmn->nProtocolVersion;
+        bool fUpdated = pmn->UpdateFromNewBroadcast(mnb, connman);
+        if(pmn->nProtocolVersion != nProtocolVersionOld) {
+            // rankings are filtered by protocol version
+            InvalidateScoresCache();
+        }
+        if(fUpdated) {
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
@@ -1425,7 +1517,13 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         CMasternode* pmn = Find(mnb.vin.prevout);
         if(pmn) {
             CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-            if(!mnb.Update(pmn, nDos, connman)) {
+            int nProtocolVersionOld = pmn->nProtocolVersion;
+            bool fUpdated = mnb.Update(pmn, nDos, connman);
+            if(pmn->nProtocolVersion != nProtocolVersionOld) {
+                // rankings are filtered by protocol version
+                InvalidateScoresCache();
+            }
+            if(!fUpdated) {
                 LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
@@ -1467,21 +1565,125 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 {
     LOCK(cs);
 
-    if(fLiteMode || !masternodeSync.IsWinnersListSynced() || mapMasternodes.empty()) return;
+    if(fLiteMode || !masternodeSync.IsWinnersListSynced() || mapMasternodes.empty() || !pindex) return;
+
+    // Only blocks we haven't scanned yet are interesting, usually that's just the new tip.
+    // Do full scan on first run or if previously scanned blocks were reorganized away.
+    const CBlockIndex* pindexStop = pindexLastPaidScanned;
+    if (pindexStop) {
+        // find the fork point
+        if (pindexStop->nHeight > pindex->nHeight)
+            pindexStop = pindexStop->GetAncestor(pindex->nHeight);
+        const CBlockIndex* pindexWalk = pindex->GetAncestor(pindexStop->nHeight);
+        while (pindexStop != pindexWalk) {
+            pindexStop = pindexStop->pprev;
+            pindexWalk = pindexWalk->pprev;
+        }
+    }
+    int nMaxBlocksToScanBack = mnpayments.GetStorageLimit();
+
+    // blocks waiting for votes which were reorganized away are replaced by the ones scanned below
+    mapLastPaidRescanVotes.erase(mapLastPaidRescanVotes.upper_bound(pindexStop ? pindexStop->nHeight : -1), mapLastPaidRescanVotes.end());
+
+    std::vector<const CBlockIndex*> vecBlocksToScan;
+    for (const CBlockIndex* pindexScan = pindex; pindexScan && pindexScan != pindexStop && (int)vecBlocksToScan.size() < nMaxBlocksToScanBack; pindexScan = pindexScan->pprev) {
+        vecBlocksToScan.push_back(pindexScan);
+    }
+
+    LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, blocks to scan=%d\n", pindex->nHeight, vecBlocksToScan.size());
+
+    // Votes for earlier blocks can arrive after these became the tip, look at them again.
+    // ScanBlockPayments skips the ones which didn't get any new votes since the last scan.
+    mapLastPaidRescanVotes.erase(mapLastPaidRescanVotes.begin(), mapLastPaidRescanVotes.upper_bound(pindex->nHeight - nMaxBlocksToScanBack));
+    for (std::map<int, int>::iterator it = mapLastPaidRescanVotes.begin(); it != mapLastPaidRescanVotes.end(); ++it) {
+        vecBlocksToScan.push_back(pindex->GetAncestor(it->first));
+    }
+
+    // scanning order doesn't matter, only payments later than the known ones are recorded
+    for (std::vector<const CBlockIndex*>::const_iterator it = vecBlocksToScan.begin(); it != vecBlocksToScan.end(); ++it) {
+        ScanBlockPayments(*it);
+    }
+
+    // payments older than the scan depth would never be found by a full scan either,
+    // forget them so that payees of removed masternodes don't stay around forever
+    std::map<CScript, std::pair<int, int64_t> >::iterator itPaid = mapPayeeLastPaid.begin();
+    while (itPaid != mapPayeeLastPaid.end()) {
+        if (itPaid->second.first <= pindex->nHeight - nMaxBlocksToScanBack) {
+            mapPayeeLastPaid.erase(itPaid++);
+        } else {
+            ++itPaid;
+        }
+    }
 
-    static bool IsFirstRun = true;
-    // Do full scan on first run or if we are not a masternode
-    // (MNs should update this info on every block, so limited scan should be enough for them)
-    int nMaxBlocksToScanBack = (IsFirstRun || !fMasterNode) ? mnpayments.GetStorageLimit() : LAST_PAID_SCAN_BLOCKS;
+    pindexLastPaidScanned = pindex;
+}
 
-    // LogPrint("mnpayments", "CMasternodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
-    //                         nCachedBlockHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
+void CMasternodeMan::ScanBlockPayments(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs);
 
-    for (auto& mnpair: mapMasternodes) {
-        mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+    // Only payees with enough votes for this block count as paid (an arbitrary output paying the
+    // right amount to some masternode does not), and only if the payment is really in the block.
+    std::set<CScript> setVotedPayees;
+    int nVotes = 0;
+    {
+        LOCK(cs_mapMasternodeBlocks);
+        std::map<int, CMasternodeBlockPayees>::iterator it = mnpayments.mapMasternodeBlocks.find(pindex->nHeight);
+        if (it != mnpayments.mapMasternodeBlocks.end()) {
+            LOCK(cs_vecPayees);
+            BOOST_FOREACH(CMasternodePayee& payee, it->second.vecPayees) {
+                nVotes += payee.GetVoteCount();
+                if (payee.GetVoteCount() >= 2)
+                    setVotedPayees.insert(payee.GetPayee());
+            }
+        }
     }
 
-    IsFirstRun = false;
+    // nothing new since the block was scanned last time
+    std::map<int, int>::iterator itRescan = mapLastPaidRescanVotes.find(pindex->nHeight);
+    if (itRescan != mapLastPaidRescanVotes.end() && itRescan->second == nVotes)
+        return;
+    // until a payment to a voted payee is found, the block is scanned again when more votes arrive
+    mapLastPaidRescanVotes[pindex->nHeight] = nVotes;
+
+    if (setVotedPayees.empty())
+        return;
+
+    CBlock block;
+    if(!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) // shouldn't really happen
+        return;
+
+    CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, block.vtx[0].GetValueOut());
+
+    BOOST_FOREACH(const CTxOut& txout, block.vtx[0].vout) {
+        if (txout.nValue != nMasternodePayment || !setVotedPayees.count(txout.scriptPubKey))
+            continue;
+        mapLastPaidRescanVotes.erase(pindex->nHeight);
+
+        std::pair<int, int64_t>& lastPaid = mapPayeeLastPaid[txout.scriptPubKey];
+        if (lastPaid.first >= pindex->nHeight)
+            continue;
+        lastPaid = std::make_pair(pindex->nHeight, (int64_t)pindex->nTime);
+
+        std::map<CScript, std::set<COutPoint> >::iterator itPayee = mapMasternodesByPayee.find(txout.scriptPubKey);
+        if (itPayee == mapMasternodesByPayee.end())
+            continue;
+        BOOST_FOREACH(const COutPoint& outpoint, itPayee->second) {
+            CMasternode* pmn = Find(outpoint);
+            if (pmn && pmn->nBlockLastPaid < pindex->nHeight) {
+                LogPrint("masternode", "CMasternodeMan::ScanBlockPayments -- found new payment to %s at %d\n", outpoint.ToStringShort(), pindex->nHeight);
+                SetLastPaid(*pmn, pindex->nHeight, pindex->nTime);
+            }
+        }
+    }
+}
+
+void CMasternodeMan::SetLastPaid(CMasternode& mn, int nBlockLastPaid, int64_t nTimeLastPaid)
+{
+    setLastPaid.erase(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+    mn.nBlockLastPaid = nBlockLastPaid;
+    mn.nTimeLastPaid = nTimeLastPaid;
+    setLastPaid.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
 }
 
 void CMasternodeMan::UpdateWatchdogVoteTime(const COutPoint& outpoint, uint64_t nVoteTime)
@@ -28,8 +28,6 @@ private:
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
 
-    static const int LAST_PAID_SCAN_BLOCKS      = 100;
-
     static const int MIN_POSE_PROTO_VERSION     = 70203;
     static const int MAX_POSE_CONNECTIONS       = 10;
     static const int MAX_POSE_RANK              = 10;
@@ -41,6 +39,19 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const size_t MAX_SCORES_CACHE_SIZE       = 32;
+
+    /// Masternode ranking for one block hash, see GetMasternodeScores
+    struct CMasternodeScores
+    {
+        // sorted by score, best first
+        score_pair_vec_t vecScores;
+        // 1-based rank of each entry in vecScores
+        std::map<COutPoint, int> mapRanks;
+        // for LRU eviction
+        uint64_t nLastUsed;
+    };
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -74,11 +85,39 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // all masternodes ordered by last paid block (then by outpoint), i.e. in payment queue order;
+    // maintained on add/remove and by UpdateLastPaid, memory only (as are the other indexes below)
+    std::set<std::pair<int, COutPoint> > setLastPaid;
+    // masternodes by collateral payee script
+    std::map<CScript, std::set<COutPoint> > mapMasternodesByPayee;
+    // last block (height, time) each payee was paid in, built from scanned coinbases and
+    // limited to the payment scan depth, see UpdateLastPaid
+    std::map<CScript, std::pair<int, int64_t> > mapPayeeLastPaid;
+    // last block scanned for masternode payments
+    const CBlockIndex* pindexLastPaidScanned;
+    // heights scanned before a payment to a voted payee could be found in them (usually because
+    // the payment votes were not there yet) and the number of votes seen then; scanned again by
+    // UpdateLastPaid once more votes arrive, limited to the payment scan depth
+    std::map<int, int> mapLastPaidRescanVotes;
+
+    // rankings keyed by block hash and minimum protocol version, memory only;
+    // flushed whenever masternodes are added, removed or updated
+    std::map<std::pair<uint256, int>, CMasternodeScores> mapScoresCache;
+    uint64_t nScoresCacheCounter;
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
 
-    bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    /// Get (cached) ranking for nBlockHash, NULL if there is none. Requires cs, valid until the list changes.
+    const CMasternodeScores* GetMasternodeScores(const uint256& nBlockHash, int nMinProtocol = 0);
+    void InvalidateScoresCache() { mapScoresCache.clear(); }
+
+    bool IsQualifiedForPayment(CMasternode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount);
+    void RebuildIndexes();
+    void RemovePayeeIndex(const CMasternode& mn);
+    void ScanBlockPayments(const CBlockIndex* pindex);
+    void SetLastPaid(CMasternode& mn, int nBlockLastPaid, int64_t nTimeLastPaid);
 
 public:
     // Keep track of all broadcasts I've seen
@@ -116,8 +155,12 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
-        if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
-            Clear();
+        if(ser_action.ForRead()) {
+            RebuildIndexes();
+            InvalidateScoresCache();
+            if(strVersion != SERIALIZATION_VERSION_STRING) {
+                Clear();
+            }
         }
     }
 
@@ -165,10 +208,14 @@ public:
     bool GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet);
     bool GetMasternodeInfo(const CScript& payee, masternode_info_t& mnInfoRet);
 
-    /// Find an entry in the masternode list that is next to be paid
+    /// Find an entry in the masternode list that is next to be paid.
+    /// nCountRet is the number of qualified masternodes looked at before the winner was known,
+    /// use CountQualifiedForPayment for the total.
     bool GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, masternode_info_t& mnInfoRet);
     /// Same as above but use current block height
     bool GetNextMasternodeInQueueForPayment(bool fFilterSigTime, int& nCountRet, masternode_info_t& mnInfoRet);
+    /// Count masternodes qualified for payment at the current block height
+    int CountQualifiedForPayment();
 
     /// Find a random entry
     masternode_info_t FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion = -1);
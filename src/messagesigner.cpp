@@ -3,12 +3,119 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "crypto/sha256.h"
 #include "hash.h"
-#include "validation.h" // For strMessageMagic
+#include "memusage.h"
+#include "random.h"
+#include "validation.h" // For strMessageMagic, RunParallelChecks
 #include "messagesigner.h"
 #include "tinyformat.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace {
+
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ */
+class CMessageSignatureCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Valid masternode message signature cache. Pings, broadcasts, votes etc. are
+ * relayed by many peers and re-checked in several places, so avoid doing the
+ * expensive public key recovery more than once for each of them.
+ */
+class CMessageSignatureCache
+{
+private:
+     //! Entries are SHA256(nonce || message hash || public key || signature):
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CMessageSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    CMessageSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32).Write(hash.begin(), 32);
+        if (pubkey.size())
+            hasher.Write(pubkey.begin(), pubkey.size());
+        if (!vchSig.empty())
+            hasher.Write(&vchSig[0], vchSig.size());
+        hasher.Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.count(entry);
+    }
+
+    void Set(const uint256& entry)
+    {
+        size_t nMaxCacheSize = GetArg("-maxmsgsigcachesize", DEFAULT_MAX_MESSAGE_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
+        {
+            map_type::size_type s = GetRand(setValid.bucket_count());
+            map_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+            }
+        }
+
+        setValid.insert(entry);
+    }
+};
+
+CMessageSignatureCache messageSignatureCache;
+
+/** Number of signatures per CMessageSigCheck */
+static const unsigned int MESSAGE_SIG_CHECK_BATCH = 16;
+
+/**
+ * Check of a run of hash signatures, see CHashSigner::VerifyHashes.
+ */
+class CMessageSigCheck
+{
+private:
+    std::vector<CHashSignature*> vSignatures;
+
+public:
+    CMessageSigCheck(std::vector<CHashSignature*>& vSignaturesIn) { vSignatures.swap(vSignaturesIn); }
+
+    bool operator()() {
+        std::string strError;
+        for (CHashSignature* psig : vSignatures) {
+            psig->fValid = CHashSigner::VerifyHash(psig->hash, psig->pubkey, psig->vchSig, strError);
+        }
+        // individual results are reported through fValid
+        return true;
+    }
+};
+
+} // anon namespace
+
 bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CBitcoinSecret vchSecret;
@@ -21,22 +128,22 @@ bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet
     return true;
 }
 
-bool CMessageSigner::SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key)
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    return ss.GetHash();
+}
 
-    return CHashSigner::SignHash(ss.GetHash(), key, vchSigRet);
+bool CMessageSigner::SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key)
+{
+    return CHashSigner::SignHash(GetMessageHash(strMessage), key, vchSigRet);
 }
 
 bool CMessageSigner::VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet)
 {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
-
-    return CHashSigner::VerifyHash(ss.GetHash(), pubkey, vchSig, strErrorRet);
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), pubkey, vchSig, strErrorRet);
 }
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet)
@@ -46,6 +153,11 @@ bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsi
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, vchSig, pubkey);
+    if (messageSignatureCache.Get(entry))
+        return true;
+
     CPubKey pubkeyFromSig;
     if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
@@ -59,5 +171,19 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const st
         return false;
     }
 
+    messageSignatureCache.Set(entry);
     return true;
 }
+
+void CHashSigner::VerifyHashes(std::vector<CHashSignature>& vecSignatures)
+{
+    std::vector<CParallelCheck> vChecks;
+    for (size_t i = 0; i < vecSignatures.size(); i += MESSAGE_SIG_CHECK_BATCH) {
+        std::vector<CHashSignature*> vBatch;
+        for (size_t j = i; j < vecSignatures.size() && j < i + MESSAGE_SIG_CHECK_BATCH; j++)
+            vBatch.push_back(&vecSignatures[j]);
+        vChecks.push_back(CParallelCheck(CMessageSigCheck(vBatch)));
+    }
+
+    RunParallelChecks(vChecks);
+}
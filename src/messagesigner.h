@@ -7,6 +7,11 @@
 
 #include "key.h"
 
+#include <vector>
+
+/** Limit the size of the masternode message signature cache to <n> MiB */
+static const unsigned int DEFAULT_MAX_MESSAGE_SIG_CACHE_SIZE = 8;
+
 /** Helper class for signing messages and checking their signatures
  */
 class CMessageSigner
@@ -18,6 +23,23 @@ public:
     static bool SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet);
+    /// Hash of the message that actually gets signed
+    static uint256 GetMessageHash(const std::string& strMessage);
+};
+
+/** A hash signature to be checked by CHashSigner::VerifyHashes
+ */
+struct CHashSignature
+{
+    uint256 hash;
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    /// Result of the check
+    bool fValid;
+
+    CHashSignature() : fValid(false) {}
+    CHashSignature(const uint256& hashIn, const CPubKey& pubkeyIn, const std::vector<unsigned char>& vchSigIn) :
+        hash(hashIn), pubkey(pubkeyIn), vchSig(vchSigIn), fValid(false) {}
 };
 
 /** Helper class for signing hashes and checking their signatures
@@ -29,6 +51,10 @@ public:
     static bool SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet);
     /// Verify the hash signature, returns true if succcessful
     static bool VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// Verify many hash signatures at once, spread over the parallel check threads.
+    /// Sets fValid of each entry. Valid signatures are cached, so verifying them again
+    /// via VerifyHash/VerifyMessage afterwards is cheap.
+    static void VerifyHashes(std::vector<CHashSignature>& vecSignatures);
 };
 
 #endif
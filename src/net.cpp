@@ -33,6 +33,13 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_POLL
+#include <poll.h>
+#endif
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -46,6 +53,10 @@
 // Dump addresses to peers.dat and banlist.dat every 15 minutes (900s)
 #define DUMP_ADDRESSES_INTERVAL 900
 
+// Maximum time (in milliseconds) the socket handler waits for socket events, which is
+// also how often it rechecks for newly queued data to send
+static const int SOCKET_EVENTS_TIMEOUT = 50;
+
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
@@ -383,7 +394,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (socketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -1053,7 +1064,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (socketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1105,6 +1116,260 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+/**
+ * Decide which readiness events the socket handler waits for on a node's socket:
+ * * If there is data to send, wait for sending data. As this only happens when
+ *   optimistic write failed, we choose to first drain the write buffer in this case
+ *   before receiving more. This avoids needlessly queueing received data, if the
+ *   remote peer is not themselves receiving data. This means properly utilizing TCP
+ *   flow control signalling.
+ * * Otherwise, if there is space left in the receive buffer, wait for receiving data.
+ * * Hand off all complete messages to the processor, to be handled without
+ *   blocking here.
+ */
+static void GetSocketInterest(CNode* pnode, bool& fWantRecv, bool& fWantSend)
+{
+    fWantRecv = false;
+    fWantSend = false;
+    {
+        TRY_LOCK(pnode->cs_vSend, lockSend);
+        if (lockSend && !pnode->vSendMsg.empty()) {
+            fWantSend = true;
+            return;
+        }
+    }
+    fWantRecv = !pnode->fPauseRecv;
+}
+
+bool CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+        {
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            error_set.insert(pnode->hSocket);
+
+            bool fWantRecv, fWantSend;
+            GetSocketInterest(pnode, fWantRecv, fWantSend);
+            if (fWantSend)
+                send_set.insert(pnode->hSocket);
+            if (fWantRecv)
+                recv_set.insert(pnode->hSocket);
+        }
+    }
+
+    return !recv_set.empty() || !send_set.empty() || !error_set.empty();
+}
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        return;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SOCKET_EVENTS_TIMEOUT * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    BOOST_FOREACH(SOCKET hSocket, recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    BOOST_FOREACH(SOCKET hSocket, send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    BOOST_FOREACH(SOCKET hSocket, error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    int nSelect = select(hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        int nErr = WSAGetLastError();
+        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        // Let the caller try every socket, failing ones will be closed on recv()
+        recv_set.insert(recv_select_set.begin(), recv_select_set.end());
+        recv_set.insert(error_select_set.begin(), error_select_set.end());
+        interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        return;
+    }
+
+    BOOST_FOREACH(SOCKET hSocket, recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+    }
+    BOOST_FOREACH(SOCKET hSocket, send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+    }
+    BOOST_FOREACH(SOCKET hSocket, error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+
+#ifdef USE_POLL
+void CConnman::SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    if (!GenerateSelectSet(recv_select_set, send_select_set, error_select_set)) {
+        interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        return;
+    }
+
+    std::map<SOCKET, struct pollfd> pollfds;
+    BOOST_FOREACH(SOCKET hSocket, recv_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLIN;
+    }
+    BOOST_FOREACH(SOCKET hSocket, send_select_set) {
+        pollfds[hSocket].fd = hSocket;
+        pollfds[hSocket].events |= POLLOUT;
+    }
+    BOOST_FOREACH(SOCKET hSocket, error_select_set) {
+        pollfds[hSocket].fd = hSocket;
+    }
+
+    std::vector<struct pollfd> vpollfds;
+    vpollfds.reserve(pollfds.size());
+    for (const auto& it : pollfds) {
+        vpollfds.push_back(it.second);
+    }
+
+    int nPoll = poll(vpollfds.data(), vpollfds.size(), SOCKET_EVENTS_TIMEOUT);
+    if (interruptNet)
+        return;
+
+    if (nPoll < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket poll error %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        }
+        return;
+    }
+
+    BOOST_FOREACH(const struct pollfd& pfd, vpollfds) {
+        if (pfd.revents & POLLIN)
+            recv_set.insert(pfd.fd);
+        if (pfd.revents & POLLOUT)
+            send_set.insert(pfd.fd);
+        if (pfd.revents & (POLLERR | POLLHUP))
+            error_set.insert(pfd.fd);
+    }
+}
+#endif
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // Sockets stay registered across calls, so only changes in what we are
+    // interested in cost an epoll_ctl() call. Listen sockets were registered
+    // (for reading) in Start().
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+        {
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            bool fWantRecv, fWantSend;
+            GetSocketInterest(pnode, fWantRecv, fWantSend);
+            int nEvents = (fWantRecv ? (int)EPOLLIN : 0) | (fWantSend ? (int)EPOLLOUT : 0);
+            if (nEvents == pnode->nSocketEventsRegistered)
+                continue;
+
+            struct epoll_event event;
+            event.events = nEvents;
+            event.data.fd = pnode->hSocket;
+            int op = pnode->nSocketEventsRegistered < 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+            if (epoll_ctl(epollfd, op, pnode->hSocket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->id, NetworkErrorString(errno));
+                pnode->fDisconnect = true;
+                continue;
+            }
+            pnode->nSocketEventsRegistered = nEvents;
+        }
+    }
+
+    // Level-triggered, so sockets we could not fully service are reported again
+    struct epoll_event events[256];
+    int nEvents = epoll_wait(epollfd, events, ARRAYLEN(events), SOCKET_EVENTS_TIMEOUT);
+    if (interruptNet)
+        return;
+
+    if (nEvents < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        SOCKET hSocket = events[i].data.fd;
+        if (events[i].events & EPOLLIN)
+            recv_set.insert(hSocket);
+        if (events[i].events & EPOLLOUT)
+            send_set.insert(hSocket);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(hSocket);
+    }
+}
+
+void CConnman::UnregisterSocketEvents(CNode* pnode)
+{
+    if (socketEventsMode != SOCKETEVENTS_EPOLL || pnode->nSocketEventsRegistered < 0)
+        return;
+    // Closing the socket removes it from the epoll set as well, but the descriptor
+    // may be shared (e.g. across fork()), so be explicit.
+    if (pnode->hSocket != INVALID_SOCKET) {
+        struct epoll_event event; // ignored, but must be non-NULL on old kernels
+        epoll_ctl(epollfd, EPOLL_CTL_DEL, pnode->hSocket, &event);
+    }
+    pnode->nSocketEventsRegistered = -1;
+}
+#endif
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    switch (socketEventsMode) {
+#ifdef USE_EPOLL
+        case SOCKETEVENTS_EPOLL:
+            SocketEventsEpoll(recv_set, send_set, error_set);
+            break;
+#endif
+#ifdef USE_POLL
+        case SOCKETEVENTS_POLL:
+            SocketEventsPoll(recv_set, send_set, error_set);
+            break;
+#endif
+        default:
+            SocketEventsSelect(recv_set, send_set, error_set);
+            break;
+    }
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1131,6 +1396,10 @@ void CConnman::ThreadSocketHandler()
                     pnode->grantOutbound.Release();
                     pnode->grantMasternodeOutbound.Release();
 
+#ifdef USE_EPOLL
+                    UnregisterSocketEvents(pnode);
+#endif
+
                     // close socket and cleanup
                     pnode->CloseSocketDisconnect();
 
@@ -1180,90 +1449,18 @@ void CConnman::ThreadSocketHandler()
                 clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
         }
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
 
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend) {
-                        if (!pnode->vSendMsg.empty()) {
-                            FD_SET(pnode->hSocket, &fdsetSend);
-                            continue;
-                        }
-                    }
-                }
-                {
-                    if (!pnode->fPauseRecv)
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1283,7 +1480,7 @@ void CConnman::ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+            if (recv_set.count(pnode->hSocket) > 0 || error_set.count(pnode->hSocket) > 0)
             {
                 {
                     {
@@ -1340,7 +1537,7 @@ void CConnman::ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend))
+            if (send_set.count(pnode->hSocket) > 0)
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend) {
@@ -1383,6 +1580,49 @@ void CConnman::ThreadSocketHandler()
     }
 }
 
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeRet)
+{
+    if (strMode == "select") {
+        modeRet = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_POLL
+    if (strMode == "poll") {
+        modeRet = SOCKETEVENTS_POLL;
+        return true;
+    }
+#endif
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        modeRet = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+        case SOCKETEVENTS_SELECT: return "select";
+        case SOCKETEVENTS_POLL:   return "poll";
+        case SOCKETEVENTS_EPOLL:  return "epoll";
+    }
+    return "unknown";
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+    std::string strModes = "select";
+#ifdef USE_POLL
+    strModes += ", poll";
+#endif
+#ifdef USE_EPOLL
+    strModes += ", epoll";
+#endif
+    return strModes;
+}
+
 void CConnman::WakeMessageHandler()
 {
     {
@@ -2138,6 +2378,10 @@ CConnman::CConnman()
     nLastNodeId = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
+    socketEventsMode = DEFAULT_SOCKETEVENTS;
+#ifdef USE_EPOLL
+    epollfd = -1;
+#endif
     semOutbound = NULL;
     semMasternodeOutbound = NULL;
     nMaxConnections = 0;
@@ -2169,6 +2413,28 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
 
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
+    socketEventsMode = connOptions.socketEventsMode;
+
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            LogPrintf("epoll_create1 failed: %s, falling back to poll\n", NetworkErrorString(errno));
+            socketEventsMode = SOCKETEVENTS_POLL;
+        } else {
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.fd = hListenSocket.socket;
+                if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+                    strNodeError = strprintf(_("Failed to register listen socket with epoll: %s"), NetworkErrorString(errno));
+                    return false;
+                }
+            }
+        }
+    }
+#endif
+    LogPrintf("Using %s for socket events\n", GetSocketEventsModeName(socketEventsMode));
 
     SetBestHeight(connOptions.nBestHeight);
 
@@ -2335,6 +2601,12 @@ void CConnman::Stop()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+#endif
 
     // clean up some globals (to help leak detection)
     BOOST_FOREACH(CNode *pnode, vNodes) {
@@ -2714,6 +2986,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     id = idIn;
     nLocalServices = nLocalServicesIn;
     fPauseRecv = false;
+    nSocketEventsRegistered = -1;
     fPauseSend = false;
     nProcessQueueSize = 0;
 
@@ -22,6 +22,7 @@
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
@@ -86,6 +87,22 @@ static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
+/** Interfaces the socket handler thread can use to wait for socket readiness */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_POLL = 1,
+    SOCKETEVENTS_EPOLL = 2,
+};
+
+/** -socketevents default */
+#if defined(USE_EPOLL)
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_EPOLL;
+#elif defined(USE_POLL)
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_POLL;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_SELECT;
+#endif
+
 static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
@@ -127,6 +144,7 @@ public:
         CClientUIInterface* uiInterface = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
     };
     CConnman();
     ~CConnman();
@@ -387,6 +405,7 @@ public:
 
 
     unsigned int GetReceiveFloodSize() const;
+    SocketEventsMode GetSocketEventsMode() const { return socketEventsMode; }
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -406,6 +425,18 @@ private:
 
     void WakeMessageHandler();
 
+    // Wait (up to 50ms) until sockets the handler is interested in become ready
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    bool GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef USE_POLL
+    void SocketEventsPoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#endif
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void UnregisterSocketEvents(CNode* pnode);
+#endif
+
     CNode* FindNode(const CNetAddr& ip);
     CNode* FindNode(const CSubNet& subNet);
     CNode* FindNode(const std::string& addrName);
@@ -461,6 +492,11 @@ private:
     unsigned int nReceiveFloodSize;
 
     std::vector<ListenSocket> vhListenSocket;
+    SocketEventsMode socketEventsMode;
+#ifdef USE_EPOLL
+    /** epoll instance holding the persistent registrations of all sockets (SOCKETEVENTS_EPOLL only) */
+    int epollfd;
+#endif
     bool fNetworkActive;
     banmap_t setBanned;
     CCriticalSection cs_setBanned;
@@ -511,6 +547,11 @@ void Discover(boost::thread_group& threadGroup);
 void MapPort(bool fUseUPnP);
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
+/** Parse a -socketevents value; fails for unknown modes and for modes not available on this platform */
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeRet);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** Comma separated list of the -socketevents modes available on this platform */
+std::string GetSupportedSocketEventsModes();
 
 struct CombinerAll
 {
@@ -719,6 +760,9 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Readiness events currently registered for hSocket with the socket handler's
+    // epoll instance (-1 if not registered). Only used by the socket handler thread.
+    int nSocketEventsRegistered;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -8,6 +8,7 @@
 #include "alert.h"
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "cachemap.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
@@ -107,8 +108,32 @@ namespace {
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
+
+    /**
+     * Serialized blocks recently sent to peers, most recently used first, so
+     * blocks requested by several peers (usually the tip) are read from disk
+     * only once and sent without being deserialized. Protected by cs_main.
+     */
+    typedef std::shared_ptr<std::vector<unsigned char> > RawBlockPtr;
+    CacheMap<uint256, RawBlockPtr> mapRawBlockCache(MAX_RAW_BLOCK_CACHE_SIZE);
 } // anon namespace
 
+static bool GetRawBlock(const CBlockIndex* pindex, RawBlockPtr& pblockRet) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const uint256& hash = pindex->GetBlockHash();
+    if (mapRawBlockCache.Get(hash, pblockRet)) {
+        // move it to the front, it's the most recently used one now
+        mapRawBlockCache.Erase(hash);
+        mapRawBlockCache.Insert(hash, pblockRet);
+        return true;
+    }
+    pblockRet = std::make_shared<std::vector<unsigned char> >();
+    if (!ReadRawBlockFromDisk(*pblockRet, pindex, Params().MessageStart()))
+        return false;
+    mapRawBlockCache.Insert(hash, pblockRet);
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Registration of network node signals.
@@ -841,13 +866,19 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
                     // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
+                    {
+                        // The block is sent as it is stored on disk, no need to deserialize it
+                        RawBlockPtr pblock;
+                        if (!GetRawBlock((*mi).second, pblock))
+                            assert(!"cannot load block from disk");
+                        connman.PushMessage(pfrom, NetMsgType::BLOCK, CFlatData(*pblock));
+                    }
                     else // MSG_FILTERED_BLOCK)
                     {
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter)
                         {
@@ -1780,6 +1811,18 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Hash the whole batch on the header check threads before the
+        // continuity check below needs the hashes under cs_main
+        CValidationState state;
+        if (!CheckBlockHeadersPoW(headers, state, chainparams.GetConsensus())) {
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), nDoS);
+            }
+            return error("invalid header received");
+        }
+
         CBlockIndex *pindexLast = NULL;
         {
         LOCK(cs_main);
@@ -1793,7 +1836,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
         }
 
-        CValidationState state;
         if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast)) {
             int nDoS;
             if (state.IsInvalid(nDoS)) {
@@ -11,15 +11,110 @@
 #include "crypto/common.h"
 #include "crypto/neoscrypt.h"
 
+/** Number of locks the header hash caches are spread over */
+static const size_t HASH_CACHE_LOCKS = 64;
+
+std::mutex& CBlockHeader::GetHashCacheLock() const
+{
+        // A lock per header would make headers expensive to create and copy,
+        // one global lock would serialize all hashing threads. Spread headers
+        // over a fixed set of locks by address instead.
+        static std::mutex locks[HASH_CACHE_LOCKS];
+        return locks[(reinterpret_cast<uintptr_t>(this) / sizeof(CBlockHeader)) % HASH_CACHE_LOCKS];
+}
+
+void CBlockHeader::CopyHashCache(const CBlockHeader& other)
+{
+        if (&other == this)
+            return;
+
+        uint256 hash;
+        unsigned char vchHeader[80];
+        bool fCached;
+        {
+            std::lock_guard<std::mutex> lock(other.GetHashCacheLock());
+            hash = other.hashCached;
+            memcpy(vchHeader, other.vchHeaderCached, sizeof(vchHeader));
+            fCached = other.fHashCached;
+        }
+
+        std::lock_guard<std::mutex> lock(GetHashCacheLock());
+        hashCached = hash;
+        memcpy(vchHeaderCached, vchHeader, sizeof(vchHeaderCached));
+        fHashCached = fCached;
+}
+
 uint256 CBlockHeader::GetHash() const
 {
+        // neoscrypt() hashes the 80 serialized header bytes starting at nVersion
+        const unsigned char* pheader = (const unsigned char *) &nVersion;
+
+        {
+            std::lock_guard<std::mutex> lock(GetHashCacheLock());
+            if (fHashCached && memcmp(vchHeaderCached, pheader, sizeof(vchHeaderCached)) == 0)
+                return hashCached;
+        }
+
+        // don't hold the lock while hashing, other headers share it
+        unsigned char vchHeader[80];
+        memcpy(vchHeader, pheader, sizeof(vchHeader));
+
         uint256 thash;
         unsigned int profile = 0x0;
-        neoscrypt((unsigned char *) &nVersion, (unsigned char *) &thash, profile);
+        neoscrypt(vchHeader, (unsigned char *) &thash, profile);
+
+        std::lock_guard<std::mutex> lock(GetHashCacheLock());
+        memcpy(vchHeaderCached, vchHeader, sizeof(vchHeaderCached));
+        hashCached = thash;
+        fHashCached = true;
         return thash;
 
 }
 
+bool CBlockHeader::HasCachedHash() const
+{
+        std::lock_guard<std::mutex> lock(GetHashCacheLock());
+        return fHashCached && memcmp(vchHeaderCached, (const unsigned char *) &nVersion, sizeof(vchHeaderCached)) == 0;
+}
+
+void CBlockHeader::SetCachedHash(const uint256& hash) const
+{
+        std::lock_guard<std::mutex> lock(GetHashCacheLock());
+        memcpy(vchHeaderCached, (const unsigned char *) &nVersion, sizeof(vchHeaderCached));
+        hashCached = hash;
+        fHashCached = true;
+}
+
+void CBlockHeader::ClearCachedHash() const
+{
+        std::lock_guard<std::mutex> lock(GetHashCacheLock());
+        fHashCached = false;
+}
+
+void CacheBlockHeaderHashes(const std::vector<const CBlockHeader*>& vHeadersIn)
+{
+    std::vector<const CBlockHeader*> vHeaders;
+    for (const CBlockHeader* pheader : vHeadersIn) {
+        if (!pheader->HasCachedHash())
+            vHeaders.push_back(pheader);
+    }
+    if (vHeaders.empty())
+        return;
+
+    std::vector<unsigned char> vInput(vHeaders.size() * 80);
+    std::vector<unsigned char> vOutput(vHeaders.size() * 32);
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        memcpy(&vInput[i * 80], &vHeaders[i]->nVersion, 80);
+
+    neoscrypt_lanes(vInput.data(), vOutput.data(), vHeaders.size());
+
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        uint256 hash;
+        memcpy(hash.begin(), &vOutput[i * 32], 32);
+        vHeaders[i]->SetCachedHash(hash);
+    }
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
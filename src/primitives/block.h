@@ -10,6 +10,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <mutex>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -28,11 +30,44 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+private:
+    // memory only
+    // NeoScrypt is expensive, so GetHash() memoizes its result together with
+    // a copy of the header bytes it was computed from. The cache is keyed by
+    // content rather than invalidated explicitly, so direct writes to the
+    // public fields above (e.g. nonce grinding in the miner) stay correct.
+    // Shared headers are hashed from several threads at once, the cache is
+    // only accessed under the lock returned by GetHashCacheLock().
+    mutable uint256 hashCached;
+    mutable unsigned char vchHeaderCached[80];
+    mutable bool fHashCached;
+
+    std::mutex& GetHashCacheLock() const;
+    void CopyHashCache(const CBlockHeader& other);
+
+public:
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other)
+    {
+        nVersion       = other.nVersion;
+        hashPrevBlock  = other.hashPrevBlock;
+        hashMerkleRoot = other.hashMerkleRoot;
+        nTime          = other.nTime;
+        nBits          = other.nBits;
+        nNonce         = other.nNonce;
+        CopyHashCache(other);
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -54,6 +89,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        ClearCachedHash();
     }
 
     bool IsNull() const
@@ -63,6 +99,15 @@ public:
 
     uint256 GetHash() const;
 
+    /** Whether GetHash() can answer from the cache without running NeoScrypt */
+    bool HasCachedHash() const;
+
+    /** Seed the hash cache with a hash already known to belong to this header */
+    void SetCachedHash(const uint256& hash) const;
+
+    /** Forget the cached hash, the next GetHash() runs NeoScrypt again */
+    void ClearCachedHash() const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -111,20 +156,19 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        return CBlockHeader(*this);
     }
 
     std::string ToString() const;
 };
 
 
+/** Hash a batch of headers with the multi-lane NeoScrypt engine and seed
+ * their hash caches, so that the following GetHash() calls are free.
+ * Headers whose cache is already valid are skipped. */
+void CacheBlockHeaderHashes(const std::vector<const CBlockHeader*>& vHeaders);
+
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
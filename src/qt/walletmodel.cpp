@@ -159,18 +159,20 @@ void WalletModel::pollBalanceChanged()
 
 void WalletModel::checkBalanceChanged()
 {
-    CAmount newBalance = getBalance();
-    CAmount newUnconfirmedBalance = getUnconfirmedBalance();
-    CAmount newImmatureBalance = getImmatureBalance();
-    CAmount newAnonymizedBalance = getAnonymizedBalance();
+    // all balances from a single snapshot
+    CWalletBalances balances = wallet->GetBalances();
+    CAmount newBalance = balances.nBalance;
+    CAmount newUnconfirmedBalance = balances.nUnconfirmedBalance;
+    CAmount newImmatureBalance = balances.nImmatureBalance;
+    CAmount newAnonymizedBalance = balances.nAnonymizedBalance;
     CAmount newWatchOnlyBalance = 0;
     CAmount newWatchUnconfBalance = 0;
     CAmount newWatchImmatureBalance = 0;
     if (haveWatchOnly())
     {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+        newWatchOnlyBalance = balances.nWatchOnlyBalance;
+        newWatchUnconfBalance = balances.nUnconfirmedWatchOnlyBalance;
+        newWatchImmatureBalance = balances.nImmatureWatchOnlyBalance;
     }
 
     if(cachedBalance != newBalance || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance ||
@@ -193,9 +193,7 @@ UniValue masternode(const UniValue& params, bool fHelp)
         if (strMode == "enabled")
             return mnodeman.CountEnabled();
 
-        int nCount;
-        masternode_info_t mnInfo;
-        mnodeman.GetNextMasternodeInQueueForPayment(true, nCount, mnInfo);
+        int nCount = mnodeman.CountQualifiedForPayment();
 
         if (strMode == "qualify")
             return nCount;
@@ -20,6 +20,7 @@
 #include "wallet/walletdb.h"
 #endif
 
+#include "instantx.h"
 #include "masternode-sync.h"
 #include "spork.h"
 
@@ -276,6 +277,46 @@ UniValue spork(const UniValue& params, bool fHelp)
 
 }
 
+UniValue getinstantsendinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getinstantsendinfo\n"
+            "\nReturns details on the InstantSend lock data kept in memory.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"lockrequestsaccepted\": xxxxx,  (numeric) Number of accepted transaction lock requests\n"
+            "  \"lockrequestsrejected\": xxxxx,  (numeric) Number of rejected transaction lock requests\n"
+            "  \"lockcandidates\": xxxxx,        (numeric) Number of transaction lock candidates\n"
+            "  \"votes\": xxxxx,                 (numeric) Number of known transaction lock votes\n"
+            "  \"orphanvotes\": xxxxx,           (numeric) Number of votes waiting for their lock request\n"
+            "  \"votedoutpoints\": xxxxx,        (numeric) Number of outpoints with votes\n"
+            "  \"lockedoutpoints\": xxxxx,       (numeric) Number of outpoints locked by completed locks\n"
+            "  \"usage\": xxxxx,                 (numeric) Total memory usage of the InstantSend data\n"
+            "  \"maxinstantsend\": xxxxx         (numeric) Maximum memory usage before data gets evicted\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendinfo", "")
+            + HelpExampleRpc("getinstantsendinfo", "")
+        );
+
+    CInstantSendStats stats;
+    instantsend.CopyStats(stats);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("lockrequestsaccepted", (int64_t)stats.nLockRequestsAccepted));
+    ret.push_back(Pair("lockrequestsrejected", (int64_t)stats.nLockRequestsRejected));
+    ret.push_back(Pair("lockcandidates", (int64_t)stats.nTxLockCandidates));
+    ret.push_back(Pair("votes", (int64_t)stats.nTxLockVotes));
+    ret.push_back(Pair("orphanvotes", (int64_t)stats.nTxLockVotesOrphan));
+    ret.push_back(Pair("votedoutpoints", (int64_t)stats.nVotedOutpoints));
+    ret.push_back(Pair("lockedoutpoints", (int64_t)stats.nLockedOutpoints));
+    ret.push_back(Pair("usage", (int64_t)stats.nMemoryUsage));
+    ret.push_back(Pair("maxinstantsend", (int64_t)stats.nMaxMemoryUsage));
+
+    return ret;
+}
+
 UniValue validateaddress(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -579,6 +620,91 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/** Maximum number of entries returned per page by the address index RPCs */
+static const int MAX_ADDRESS_PAGE_SIZE = 10000;
+
+bool getPaginationFromParams(const UniValue& params, size_t &limit, std::string &cursor)
+{
+    if (!params[0].isObject())
+        return false;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (limitValue.isNull())
+        return false;
+
+    int nLimit = limitValue.get_int();
+    if (nLimit <= 0 || nLimit > MAX_ADDRESS_PAGE_SIZE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Limit is expected to be between 1 and %d", MAX_ADDRESS_PAGE_SIZE));
+    }
+    limit = nLimit;
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (!cursorValue.isNull()) {
+        cursor = cursorValue.get_str();
+    }
+
+    return true;
+}
+
+/** Cursors are the database key the next page starts at, hex encoded */
+template<typename Key>
+UniValue encodeIndexCursor(const Key &key)
+{
+    if (key.IsNull())
+        return NullUniValue;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+/** Decode a cursor and return the position of the address it continues at */
+template<typename Key>
+size_t decodeIndexCursor(const std::vector<std::pair<uint160, int> > &addresses, const std::string &strCursor, Key &key)
+{
+    if (strCursor.empty())
+        return 0;
+
+    if (!IsHex(strCursor))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor must be hexadecimal string");
+
+    std::vector<unsigned char> vchCursor(ParseHex(strCursor));
+    CDataStream ss(vchCursor, SER_DISK, CLIENT_VERSION);
+    try {
+        ss >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor decode failed");
+    }
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i].first == key.hashBytes && addresses[i].second == (int)key.type) {
+            return i;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to any of the addresses");
+}
+
+/** Read up to limit address index entries starting at cursor, return the cursor of the next page */
+UniValue getAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                             size_t limit, const std::string &strCursor,
+                             std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    CAddressIndexKey cursor;
+    for (size_t i = decodeIndexCursor(addresses, strCursor, cursor); i < addresses.size(); i++) {
+        if (addressIndex.size() == limit) {
+            cursor = CAddressIndexKey(addresses[i].second, addresses[i].first, (start > 0 && end > 0) ? start : 0, 0, uint256(), 0, false);
+            break;
+        }
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, addressIndex, start, end, limit - addressIndex.size(), &cursor)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (!cursor.IsNull())
+            break;
+    }
+
+    return encodeIndexCursor(cursor);
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -673,6 +799,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many outputs, in index order, together with a cursor\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous page\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -685,8 +813,14 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, null if there are no more outputs\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -696,15 +830,34 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t limit = 0;
+    std::string strCursor;
+    bool fPaginate = getPaginationFromParams(params, limit, strCursor);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    CAddressUnspentKey cursor;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (fPaginate) {
+        for (size_t i = decodeIndexCursor(addresses, strCursor, cursor); i < addresses.size(); i++) {
+            if (unspentOutputs.size() == limit) {
+                cursor = CAddressUnspentKey(addresses[i].second, addresses[i].first, uint256(), 0);
+                break;
+            }
+            if (!GetAddressUnspent(addresses[i].first, addresses[i].second, unspentOutputs, limit - unspentOutputs.size(), &cursor)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            if (!cursor.IsNull())
+                break;
+        }
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-    }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -724,6 +877,13 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (fPaginate) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("utxos", result));
+        page.push_back(Pair("cursor", encodeIndexCursor(cursor)));
+        return page;
+    }
+
     return result;
 }
 
@@ -742,6 +902,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many deltas, in index order, together with a cursor\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -754,8 +916,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas as above\n"
+            "  \"cursor\"  (string) The cursor of the next page, null if there are no more deltas\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -780,16 +948,25 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t limit = 0;
+    std::string strCursor;
+    bool fPaginate = getPaginationFromParams(params, limit, strCursor);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    UniValue cursor;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (fPaginate) {
+        cursor = getAddressIndexPage(addresses, start, end, limit, strCursor, addressIndex);
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (start > 0 && end > 0) {
+                if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+                }
+            } else {
+                if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+                }
             }
         }
     }
@@ -812,6 +989,13 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
+    if (fPaginate) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("deltas", result));
+        page.push_back(Pair("cursor", cursor));
+        return page;
+    }
+
     return result;
 }
 
@@ -845,22 +1029,16 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummaryValue summary;
+        if (!GetAddressSummary((*it).first, (*it).second, summary)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += summary.balance;
+        received += summary.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -886,14 +1064,22 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Read at most this many index entries, in index order, and return a cursor\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids as above, a txid may be repeated on the next page\n"
+            "  \"cursor\"  (string) The cursor of the next page, null if there are no more entries\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -914,16 +1100,25 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
+    size_t limit = 0;
+    std::string strCursor;
+    bool fPaginate = getPaginationFromParams(params, limit, strCursor);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    UniValue cursor;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (fPaginate) {
+        cursor = getAddressIndexPage(addresses, start, end, limit, strCursor, addressIndex);
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (start > 0 && end > 0) {
+                if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+                }
+            } else {
+                if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+                }
             }
         }
     }
@@ -935,7 +1130,7 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         int height = it->first.blockHeight;
         std::string txid = it->first.txhash.GetHex();
 
-        if (addresses.size() > 1) {
+        if (addresses.size() > 1 && !fPaginate) {
             txids.insert(std::make_pair(height, txid));
         } else {
             if (txids.insert(std::make_pair(height, txid)).second) {
@@ -944,12 +1139,19 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
-    if (addresses.size() > 1) {
+    if (addresses.size() > 1 && !fPaginate) {
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
         }
     }
 
+    if (fPaginate) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("txids", result));
+        page.push_back(Pair("cursor", cursor));
+        return page;
+    }
+
     return result;
 
 }
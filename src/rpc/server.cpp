@@ -353,6 +353,7 @@ static const CRPCCommand vRPCCommands[] =
     { "sparks",               "voteraw",                &voteraw,                true  },
     { "sparks",               "mnsync",                 &mnsync,                 true  },
     { "sparks",               "spork",                  &spork,                  true  },
+    { "sparks",               "getinstantsendinfo",     &getinstantsendinfo,     true  },
     { "sparks",               "getpoolinfo",            &getpoolinfo,            true  },
     { "sparks",               "sentinelping",           &sentinelping,           true  },
 #ifdef ENABLE_WALLET
@@ -198,6 +198,10 @@ struct CAddressUnspentKey {
         txhash.SetNull();
         index = 0;
     }
+
+    bool IsNull() const {
+        return type == 0;
+    }
 };
 
 struct CAddressUnspentValue {
@@ -296,6 +300,10 @@ struct CAddressIndexKey {
         spending = false;
     }
 
+    bool IsNull() const {
+        return type == 0;
+    }
+
 };
 
 struct CAddressIndexIteratorKey {
@@ -369,5 +377,32 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+struct CAddressSummaryValue {
+    CAmount balance;
+    CAmount received;
+    unsigned int txCount;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummaryValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        lastHeight = 0;
+    }
+};
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -530,6 +530,9 @@ public:
         }
     }
 
+    int GetType()                { return nType; }
+    int GetVersion()             { return nVersion; }
+
     // check whether we're at the end of the source file
     bool eof() const {
         return nReadPos == nSrcPos && feof(src);
@@ -0,0 +1,152 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "txdb.h"
+#include "test/test_sparks.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(addressindex_summary)
+{
+    CAddressIndexDB db(1 << 20, true);
+    uint160 addressHash;
+    GetRandBytes(addressHash.begin(), addressHash.size());
+    uint256 txhash1 = GetRandHash();
+    uint256 txhash2 = GetRandHash();
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vecBlock1;
+    vecBlock1.push_back(std::make_pair(CAddressIndexKey(1, addressHash, 10, 1, txhash1, 0, false), 50));
+    vecBlock1.push_back(std::make_pair(CAddressIndexKey(1, addressHash, 10, 1, txhash1, 1, false), 20));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vecBlock2;
+    vecBlock2.push_back(std::make_pair(CAddressIndexKey(1, addressHash, 12, 1, txhash2, 0, true), -50));
+    vecBlock2.push_back(std::make_pair(CAddressIndexKey(1, addressHash, 12, 1, txhash2, 1, false), 30));
+
+    BOOST_CHECK(db.WriteAddressIndex(vecBlock1, true));
+    BOOST_CHECK(db.WriteAddressIndex(vecBlock2, true));
+    // writing the same block again must not count it twice
+    BOOST_CHECK(db.WriteAddressIndex(vecBlock2, true));
+
+    CAddressSummaryValue summary;
+    BOOST_CHECK(db.ReadAddressSummary(addressHash, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 50);
+    BOOST_CHECK_EQUAL(summary.received, 100);
+    BOOST_CHECK_EQUAL(summary.txCount, 2U);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 12);
+
+    // other address types are kept apart
+    BOOST_CHECK(db.ReadAddressSummary(addressHash, 2, summary));
+    BOOST_CHECK_EQUAL(summary.txCount, 0U);
+
+    BOOST_CHECK(db.EraseAddressIndex(vecBlock2, true));
+    BOOST_CHECK(db.EraseAddressIndex(vecBlock2, true));
+    BOOST_CHECK(db.ReadAddressSummary(addressHash, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 70);
+    BOOST_CHECK_EQUAL(summary.received, 70);
+    BOOST_CHECK_EQUAL(summary.txCount, 1U);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 10);
+
+    BOOST_CHECK(db.EraseAddressIndex(vecBlock1, true));
+    BOOST_CHECK(db.ReadAddressSummary(addressHash, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 0);
+    BOOST_CHECK_EQUAL(summary.txCount, 0U);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 0);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_pagination)
+{
+    CAddressIndexDB db(1 << 20, true);
+    uint160 addressHash;
+    GetRandBytes(addressHash.begin(), addressHash.size());
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vecDeltas;
+    for (int i = 0; i < 5; i++) {
+        vecDeltas.push_back(std::make_pair(CAddressIndexKey(1, addressHash, 10 + i, 1, GetRandHash(), 0, false), 10));
+    }
+    BOOST_CHECK(db.WriteAddressIndex(vecDeltas));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vecPage;
+    CAddressIndexKey cursor;
+    BOOST_CHECK(db.ReadAddressIndex(addressHash, 1, vecPage, 0, 0, 2, &cursor));
+    BOOST_CHECK_EQUAL(vecPage.size(), 2U);
+    BOOST_CHECK(!cursor.IsNull());
+    BOOST_CHECK_EQUAL(cursor.blockHeight, 12);
+
+    BOOST_CHECK(db.ReadAddressIndex(addressHash, 1, vecPage, 0, 0, 2, &cursor));
+    BOOST_CHECK_EQUAL(vecPage.size(), 4U);
+    BOOST_CHECK_EQUAL(cursor.blockHeight, 14);
+
+    // the last page has no cursor
+    BOOST_CHECK(db.ReadAddressIndex(addressHash, 1, vecPage, 0, 0, 2, &cursor));
+    BOOST_CHECK_EQUAL(vecPage.size(), 5U);
+    BOOST_CHECK(cursor.IsNull());
+
+    for (size_t i = 0; i < vecDeltas.size(); i++) {
+        BOOST_CHECK(vecPage[i].first.txhash == vecDeltas[i].first.txhash);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_move_legacy)
+{
+    // older versions kept the indexes in the block tree database, under the same keys
+    CBlockTreeDB blocktree(1 << 20, true);
+    uint160 addressHash;
+    GetRandBytes(addressHash.begin(), addressHash.size());
+    uint256 txhash = GetRandHash();
+
+    CAddressIndexKey addressKey(1, addressHash, 10, 1, txhash, 0, false);
+    CAddressUnspentKey unspentKey(1, addressHash, txhash, 0);
+    CSpentIndexKey spentKey(GetRandHash(), 3);
+    CTimestampIndexKey timestampKey(1500000000, GetRandHash());
+    BOOST_CHECK(blocktree.Write(std::make_pair('a', addressKey), (CAmount)50));
+    BOOST_CHECK(blocktree.Write(std::make_pair('u', unspentKey), CAddressUnspentValue(50, CScript(), 10)));
+    BOOST_CHECK(blocktree.Write(std::make_pair('p', spentKey), CSpentIndexValue(txhash, 0, 11, 50, 1, addressHash)));
+    BOOST_CHECK(blocktree.Write(std::make_pair('s', timestampKey), 0));
+
+    CAddressIndexDB addressdb(1 << 20, true);
+    CSpentIndexDB spentdb(1 << 20, true);
+    CTimestampIndexDB timestampdb(1 << 20, true);
+    BOOST_CHECK(blocktree.MoveLegacyIndexes(&addressdb, &spentdb, &timestampdb));
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('a', addressKey)));
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('u', unspentKey)));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vecDeltas;
+    BOOST_CHECK(addressdb.ReadAddressIndex(addressHash, 1, vecDeltas));
+    BOOST_CHECK_EQUAL(vecDeltas.size(), 1U);
+    BOOST_CHECK_EQUAL(vecDeltas[0].second, 50);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vecUnspent;
+    BOOST_CHECK(addressdb.ReadAddressUnspentIndex(addressHash, 1, vecUnspent));
+    BOOST_CHECK_EQUAL(vecUnspent.size(), 1U);
+    BOOST_CHECK_EQUAL(vecUnspent[0].second.blockHeight, 10);
+
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(spentdb.ReadSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(spentValue.txid == txhash);
+    BOOST_CHECK_EQUAL(spentValue.blockHeight, 11);
+
+    std::vector<uint256> vecHashes;
+    BOOST_CHECK(timestampdb.ReadTimestampIndex(1500000000, 1500000000, vecHashes));
+    BOOST_CHECK_EQUAL(vecHashes.size(), 1U);
+    BOOST_CHECK(vecHashes[0] == timestampKey.blockHash);
+
+    // moving again finds nothing left to move
+    BOOST_CHECK(blocktree.MoveLegacyIndexes(&addressdb, &spentdb, &timestampdb));
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('p', spentKey)));
+    BOOST_CHECK(spentdb.ReadSpentIndex(spentKey, spentValue));
+
+    // entries of indexes which are not moved are left for EraseLegacyIndexes
+    BOOST_CHECK(blocktree.Write(std::make_pair('s', timestampKey), 0));
+    BOOST_CHECK(blocktree.MoveLegacyIndexes(&addressdb, &spentdb, NULL));
+    BOOST_CHECK(blocktree.Exists(std::make_pair('s', timestampKey)));
+    BOOST_CHECK(blocktree.EraseLegacyIndexes());
+    BOOST_CHECK(!blocktree.Exists(std::make_pair('s', timestampKey)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/neoscrypt.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_sparks.h"
@@ -273,4 +274,41 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+BOOST_AUTO_TEST_CASE(neoscrypt_lanes_test) {
+    const unsigned int vExts[] = {NEOSCRYPT_VEC_SSE2, NEOSCRYPT_VEC_AVX2, NEOSCRYPT_VEC_AVX512};
+    const unsigned int vWidths[] = {4, 8, 16};
+    unsigned int nEngines = neoscrypt_lanes_exts();
+
+    for (unsigned int e = 0; e < sizeof(vExts) / sizeof(vExts[0]); e++) {
+        if (!(nEngines & vExts[e]))
+            continue;
+        // Fewer inputs than lanes, exactly one group, and groups plus a scalar tail
+        const unsigned int vCounts[] = {1, vWidths[e] - 1, vWidths[e], 2 * vWidths[e] + 3};
+        for (unsigned int c = 0; c < sizeof(vCounts) / sizeof(vCounts[0]); c++) {
+            unsigned int nCount = vCounts[c];
+            std::vector<unsigned char> vInput(nCount * 80);
+            for (size_t i = 0; i < vInput.size(); i++)
+                vInput[i] = insecure_rand();
+
+            std::vector<unsigned char> vExpected(nCount * 32), vOutput(nCount * 32);
+            for (unsigned int i = 0; i < nCount; i++)
+                neoscrypt(&vInput[i * 80], &vExpected[i * 32], 0);
+            neoscrypt_lanes_ext(vInput.data(), vOutput.data(), nCount, vExts[e]);
+            BOOST_CHECK_MESSAGE(vOutput == vExpected, strprintf("engine %u, %u inputs", vWidths[e], nCount));
+        }
+    }
+
+    // The default dispatch uses the widest of them
+    unsigned int nCount = 2 * neoscrypt_lanes_width() + 3;
+    std::vector<unsigned char> vInput(nCount * 80);
+    for (size_t i = 0; i < vInput.size(); i++)
+        vInput[i] = insecure_rand();
+
+    std::vector<unsigned char> vExpected(nCount * 32), vOutput(nCount * 32);
+    for (unsigned int i = 0; i < nCount; i++)
+        neoscrypt(&vInput[i * 80], &vExpected[i * 32], 0);
+    neoscrypt_lanes(vInput.data(), vOutput.data(), nCount);
+    BOOST_CHECK(vOutput == vExpected);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-votedb.h"
+#include "random.h"
+#include "test/test_sparks.h"
+
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(governance_votedb_memory_limit)
+{
+    CGovernanceVoteDB db(1 << 20, true);
+    pgovernancevotedb = &db;
+
+    uint256 nParentHash = GetRandHash();
+    std::vector<CGovernanceVote> vecVotes;
+    for(int i = 0; i < 150; ++i) {
+        vecVotes.push_back(CGovernanceVote(COutPoint(GetRandHash(), i), nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    }
+
+    CGovernanceObjectVoteFile fileVotes;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        fileVotes.AddVote(vecVotes[i]);
+    }
+
+    // only the most recent votes are kept in memory, all of them are on disk
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 150);
+    BOOST_CHECK_EQUAL(fileVotes.GetMemoryVotes().size(), 100U);
+    BOOST_CHECK_EQUAL(fileVotes.GetVotes().size(), 150U);
+
+    CGovernanceVote vote;
+    BOOST_CHECK(fileVotes.HasVote(vecVotes[0].GetHash()));
+    BOOST_CHECK(fileVotes.GetVote(vecVotes[0].GetHash(), vote));
+    BOOST_CHECK(vote.GetHash() == vecVotes[0].GetHash());
+    BOOST_CHECK(fileVotes.GetMemoryVotes()[0].GetHash() == vecVotes[0].GetHash());
+    BOOST_CHECK(!fileVotes.HasVote(GetRandHash()));
+
+    uint256 nParentHashRet;
+    BOOST_CHECK(db.ReadVoteParent(vecVotes[1].GetHash(), nParentHashRet));
+    BOOST_CHECK(nParentHashRet == nParentHash);
+
+    // a second vote of the same masternode on another signal
+    CGovernanceVote voteDelete(vecVotes[1].GetMasternodeOutpoint(), nParentHash, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_NO);
+    fileVotes.AddVote(voteDelete);
+    std::vector<CGovernanceVote> vecMasternodeVotes;
+    BOOST_CHECK(db.ReadMasternodeVotes(nParentHash, vecVotes[1].GetMasternodeOutpoint(), vecMasternodeVotes));
+    BOOST_CHECK_EQUAL(vecMasternodeVotes.size(), 2U);
+
+    fileVotes.RemoveVotesFromMasternode(vecVotes[1].GetMasternodeOutpoint());
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 149);
+    BOOST_CHECK(!fileVotes.HasVote(vecVotes[1].GetHash()));
+    BOOST_CHECK(!fileVotes.HasVote(voteDelete.GetHash()));
+    BOOST_CHECK(!db.ReadVoteParent(vecVotes[1].GetHash(), nParentHashRet));
+    vecMasternodeVotes.clear();
+    BOOST_CHECK(db.ReadMasternodeVotes(nParentHash, vecVotes[1].GetMasternodeOutpoint(), vecMasternodeVotes));
+    BOOST_CHECK(vecMasternodeVotes.empty());
+    BOOST_CHECK(db.ReadMasternodeVotes(nParentHash, vecVotes[2].GetMasternodeOutpoint(), vecMasternodeVotes));
+    BOOST_CHECK_EQUAL(vecMasternodeVotes.size(), 1U);
+
+    fileVotes.RemoveAllVotes();
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 0);
+    BOOST_CHECK(fileVotes.GetVotes().empty());
+    BOOST_CHECK(!db.ReadVoteParent(vecVotes[2].GetHash(), nParentHashRet));
+
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(governance_votedb_load_votes)
+{
+    CGovernanceVoteDB db(1 << 20, true);
+    pgovernancevotedb = &db;
+
+    uint256 nParentHash = GetRandHash();
+    uint256 nParentHashOther = GetRandHash();
+    CGovernanceObjectVoteFile fileVotes;
+    for(int i = 0; i < 3; ++i) {
+        fileVotes.AddVote(CGovernanceVote(COutPoint(GetRandHash(), i), nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    }
+    CGovernanceObjectVoteFile fileVotesOther;
+    fileVotesOther.AddVote(CGovernanceVote(COutPoint(GetRandHash(), 0), nParentHashOther, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+
+    std::set<uint256> setParentHashes;
+    BOOST_CHECK(db.ReadParentHashes(setParentHashes));
+    BOOST_CHECK_EQUAL(setParentHashes.size(), 2U);
+    BOOST_CHECK(setParentHashes.count(nParentHash) && setParentHashes.count(nParentHashOther));
+
+    // a vote file loaded from an older governance.dat doesn't know about all votes yet
+    CGovernanceObjectVoteFile fileVotesLoaded;
+    std::vector<CGovernanceVote> vecVotes;
+    BOOST_CHECK(fileVotesLoaded.LoadVotes(nParentHash, vecVotes));
+    BOOST_CHECK_EQUAL(vecVotes.size(), 3U);
+    BOOST_CHECK_EQUAL(fileVotesLoaded.GetVoteCount(), 3);
+    BOOST_CHECK(fileVotesLoaded.HasVote(vecVotes[0].GetHash()));
+
+    pgovernancevotedb = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(governance_votedb_clean_shutdown)
+{
+    CGovernanceVoteDB db(1 << 20, true);
+    BOOST_CHECK(!db.ReadCleanShutdown());
+    BOOST_CHECK(db.WriteCleanShutdown(true));
+    BOOST_CHECK(db.ReadCleanShutdown());
+    BOOST_CHECK(db.WriteCleanShutdown(false));
+    BOOST_CHECK(!db.ReadCleanShutdown());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "indexbuilder.h"
+#include "txdb.h"
+#include "validation.h"
+#include "test/test_sparks.h"
+
+#include <limits>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+struct IndexBuilderSetup : public TestChain100Setup {
+    IndexBuilderSetup()
+    {
+        paddressindexdb = new CAddressIndexDB(1 << 20, true);
+        pspentindexdb = new CSpentIndexDB(1 << 20, true);
+        ptimestampindexdb = new CTimestampIndexDB(1 << 20, true);
+    }
+
+    ~IndexBuilderSetup()
+    {
+        // built indexes are switched on globally, later tests don't have the databases
+        fAddressIndex = false;
+        fAddressSummaryIndex = false;
+        fSpentIndex = false;
+        fTimestampIndex = false;
+        delete paddressindexdb;
+        delete pspentindexdb;
+        delete ptimestampindexdb;
+        paddressindexdb = NULL;
+        pspentindexdb = NULL;
+        ptimestampindexdb = NULL;
+    }
+
+    size_t CountTimestampEntries()
+    {
+        std::vector<uint256> vHashes;
+        BOOST_CHECK(ptimestampindexdb->ReadTimestampIndex(std::numeric_limits<unsigned int>::max(), 0, vHashes));
+        return vHashes.size();
+    }
+
+    size_t CountAddressEntries(const CKeyID& keyID)
+    {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+        BOOST_CHECK(paddressindexdb->ReadAddressIndex(uint160(keyID), 1, vEntries));
+        return vEntries.size();
+    }
+
+    size_t CountAddressUnspent(const CKeyID& keyID)
+    {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+        BOOST_CHECK(paddressindexdb->ReadAddressUnspentIndex(uint160(keyID), 1, vUnspent));
+        return vUnspent.size();
+    }
+};
+
+static CScript GetP2PKHScript(const CKeyID& keyID)
+{
+    return CScript() << OP_DUP << OP_HASH160 << ToByteVector(keyID) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+BOOST_FIXTURE_TEST_SUITE(indexbuilder_tests, IndexBuilderSetup)
+
+BOOST_AUTO_TEST_CASE(indexbuilder_resume)
+{
+    CIndexBuildProgress progress;
+    progress.fTimestampIndex = true;
+    {
+        LOCK(cs_main);
+        progress.hashBestBlock = chainActive[50]->GetBlockHash();
+    }
+    BOOST_CHECK(pblocktree->WriteIndexBuildProgress(progress));
+
+    // the stored build covers the wanted indexes, it is resumed
+    CIndexBuildProgress wanted;
+    wanted.fTimestampIndex = true;
+    BOOST_CHECK(PrepareIndexBuild(wanted));
+    BOOST_CHECK(wanted.hashBestBlock == progress.hashBestBlock);
+
+    BOOST_CHECK(!fTimestampIndex);
+    BOOST_CHECK(BuildIndexes(wanted, 2));
+
+    // only blocks after the stored one were indexed
+    BOOST_CHECK_EQUAL(CountTimestampEntries(), 50U);
+
+    // the index is complete and switched on
+    bool fFlag = false;
+    BOOST_CHECK(fTimestampIndex);
+    BOOST_CHECK(pblocktree->ReadFlag("timestampindex", fFlag) && fFlag);
+    BOOST_CHECK(!pblocktree->ReadIndexBuildProgress(progress));
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_restart_when_index_added)
+{
+    CIndexBuildProgress progress;
+    progress.fTimestampIndex = true;
+    {
+        LOCK(cs_main);
+        progress.hashBestBlock = chainActive[50]->GetBlockHash();
+    }
+    BOOST_CHECK(pblocktree->WriteIndexBuildProgress(progress));
+
+    // the stored build lacks the spent index, start over
+    CIndexBuildProgress wanted;
+    wanted.fTimestampIndex = true;
+    wanted.fSpentIndex = true;
+    BOOST_CHECK(PrepareIndexBuild(wanted));
+    BOOST_CHECK(wanted.hashBestBlock.IsNull());
+
+    CIndexBuildProgress stored;
+    BOOST_CHECK(pblocktree->ReadIndexBuildProgress(stored));
+    BOOST_CHECK(stored.fSpentIndex && stored.fTimestampIndex && stored.hashBestBlock.IsNull());
+
+    BOOST_CHECK(BuildIndexes(wanted, 1));
+    BOOST_CHECK_EQUAL(CountTimestampEntries(), 100U);
+    BOOST_CHECK(fSpentIndex && fTimestampIndex);
+    BOOST_CHECK(!fAddressIndex);
+}
+
+BOOST_AUTO_TEST_CASE(indexbuilder_reorg)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    std::vector<CMutableTransaction> noTxns;
+
+    CBlock block = CreateAndProcessBlock(noTxns, GetP2PKHScript(key.GetPubKey().GetID()));
+    CBlockIndex* pindexStale;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        pindexStale = chainActive.Tip();
+    }
+
+    CIndexBuildProgress progress;
+    progress.fAddressIndex = true;
+    progress.hashBestBlock = pindexStale->pprev->GetBlockHash();
+    BOOST_CHECK(BuildIndexes(progress, 1));
+    BOOST_CHECK(CountAddressEntries(key.GetPubKey().GetID()) > 0);
+    BOOST_CHECK(CountAddressUnspent(key.GetPubKey().GetID()) > 0);
+
+    // Pretend the build was interrupted right after indexing the tip,
+    // which is then replaced by another block while the builder is away
+    fAddressIndex = false;
+    fAddressSummaryIndex = false;
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), pindexStale));
+    }
+    CreateAndProcessBlock(noTxns, GetP2PKHScript(keyOther.GetPubKey().GetID()));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip() != pindexStale);
+        BOOST_CHECK(chainActive.Height() == pindexStale->nHeight);
+    }
+
+    progress.hashBestBlock = pindexStale->GetBlockHash();
+    BOOST_CHECK(BuildIndexes(progress, 1));
+
+    // entries of the stale block are undone, the new tip is indexed
+    BOOST_CHECK_EQUAL(CountAddressEntries(key.GetPubKey().GetID()), 0U);
+    BOOST_CHECK_EQUAL(CountAddressUnspent(key.GetPubKey().GetID()), 0U);
+    BOOST_CHECK(CountAddressEntries(keyOther.GetPubKey().GetID()) > 0);
+    BOOST_CHECK(CountAddressUnspent(keyOther.GetPubKey().GetID()) > 0);
+    BOOST_CHECK(fAddressIndex);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
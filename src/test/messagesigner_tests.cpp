@@ -0,0 +1,69 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "messagesigner.h"
+#include "test/test_sparks.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messagesigner_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(messagesigner_verify_cached)
+{
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    CPubKey pubkeyOther = keyOther.GetPubKey();
+
+    std::string strMessage = "outpoint|parenthash|1|1|1500000000";
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(CMessageSigner::SignMessage(strMessage, vchSig, key));
+
+    std::string strError;
+    // twice: the second check is answered from the cache
+    BOOST_CHECK(CMessageSigner::VerifyMessage(pubkey, vchSig, strMessage, strError));
+    BOOST_CHECK(CMessageSigner::VerifyMessage(pubkey, vchSig, strMessage, strError));
+    BOOST_CHECK(CHashSigner::VerifyHash(CMessageSigner::GetMessageHash(strMessage), pubkey, vchSig, strError));
+
+    // a cached signature must not validate anything else
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(pubkeyOther, vchSig, strMessage, strError));
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(pubkey, vchSig, strMessage + "x", strError));
+    std::vector<unsigned char> vchSigBad(vchSig);
+    vchSigBad[10] ^= 1;
+    BOOST_CHECK(!CMessageSigner::VerifyMessage(pubkey, vchSigBad, strMessage, strError));
+}
+
+BOOST_AUTO_TEST_CASE(messagesigner_verify_batch)
+{
+    std::vector<CKey> vKeys(5);
+    for (CKey& key : vKeys)
+        key.MakeNewKey(true);
+
+    std::vector<CHashSignature> vecSignatures;
+    for (int i = 0; i < 40; i++) {
+        const CKey& key = vKeys[i % vKeys.size()];
+        uint256 hash = CMessageSigner::GetMessageHash(strprintf("message %d", i));
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(CHashSigner::SignHash(hash, key, vchSig));
+        // every third one is signed by the wrong key
+        CPubKey pubkey = (i % 3 == 0) ? vKeys[(i + 1) % vKeys.size()].GetPubKey() : key.GetPubKey();
+        vecSignatures.push_back(CHashSignature(hash, pubkey, vchSig));
+    }
+
+    CHashSigner::VerifyHashes(vecSignatures);
+
+    std::string strError;
+    for (size_t i = 0; i < vecSignatures.size(); i++) {
+        const CHashSignature& sig = vecSignatures[i];
+        BOOST_CHECK_EQUAL(sig.fValid, i % 3 != 0);
+        BOOST_CHECK_EQUAL(CHashSigner::VerifyHash(sig.hash, sig.pubkey, sig.vchSig, strError), i % 3 != 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,7 +9,9 @@
 #include "util.h"
 #include "test/test_sparks.h"
 
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 
@@ -190,4 +192,56 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(header_hash_cache)
+{
+    const CBlock& genesis = Params(CBaseChainParams::MAIN).GenesisBlock();
+
+    CBlockHeader header = genesis.GetBlockHeader();
+    header.ClearCachedHash();
+    uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == Params(CBaseChainParams::MAIN).GetConsensus().hashGenesisBlock);
+    BOOST_CHECK(header.HasCachedHash());
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // Mutating a field must not return the stale cached hash
+    header.nNonce++;
+    uint256 hashMutated = header.GetHash();
+    BOOST_CHECK(hashMutated != hash);
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // Copies carry the cache and it stays keyed by content
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    block.hashMerkleRoot.SetNull();
+    BOOST_CHECK(block.GetHash() != hash);
+}
+
+static void HashHeaderRepeatedly(const CBlockHeader* pheader, const uint256* phash, bool* pfMatch)
+{
+    for (int i = 0; i < 100; i++) {
+        if (i % 10 == 0)
+            pheader->ClearCachedHash();
+        if (pheader->GetHash() != *phash)
+            *pfMatch = false;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(header_hash_cache_threads)
+{
+    // A header shared between threads is hashed and re-cached concurrently
+    const CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    const uint256 hash = Params(CBaseChainParams::MAIN).GetConsensus().hashGenesisBlock;
+
+    bool fMatch[4] = {true, true, true, true};
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&HashHeaderRepeatedly, &header, &hash, &fMatch[i]));
+    threads.join_all();
+
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(fMatch[i]);
+    BOOST_CHECK(header.GetHash() == hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,41 @@
+// Copyright (c) 2014-2017 The Sparks Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "streams.h"
+#include "validation.h"
+#include "test/test_sparks.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(rawblock_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(rawblock_matches_serialized_block)
+{
+    LOCK(cs_main);
+
+    for (int nHeight = 0; nHeight <= chainActive.Height(); nHeight += 25) {
+        CBlockIndex* pindex = chainActive[nHeight];
+
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+
+        std::vector<unsigned char> vchRaw;
+        BOOST_CHECK(ReadRawBlockFromDisk(vchRaw, pindex, Params().MessageStart()));
+        BOOST_CHECK_EQUAL(vchRaw.size(), ssBlock.size());
+        // the stream holds signed chars, compare as bytes
+        BOOST_CHECK(vchRaw == std::vector<unsigned char>(ssBlock.begin(), ssBlock.end()));
+    }
+
+    // the magic in front of the block is checked
+    CMessageHeader::MessageStartChars wrongMessageStart = {0x00, 0x00, 0x00, 0x00};
+    std::vector<unsigned char> vchRaw;
+    BOOST_CHECK(!ReadRawBlockFromDisk(vchRaw, chainActive.Tip(), wrongMessageStart));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -76,6 +76,9 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        nParCheckThreads = 2;
+        for (int i=0; i < nParCheckThreads; i++)
+            threadGroup.create_thread(&ThreadParallelCheck);
         g_connman = std::unique_ptr<CConnman>(new CConnman());
         connman = g_connman.get();
         RegisterNodeSignals(GetNodeSignals());
@@ -123,6 +126,12 @@ CBlock
 TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
 {
     const CChainParams& chainparams = Params();
+    {
+        // Regtest starts out at the genesis difficulty, only blocks spaced further apart than
+        // twice the target spacing may use the minimum difficulty. Move the clock forward.
+        LOCK(cs_main);
+        SetMockTime(std::max(GetTime(), chainActive.Tip()->GetBlockTime()) + 2 * chainparams.GetConsensus().nPowTargetSpacing + 1);
+    }
     CBlockTemplate *pblocktemplate = CreateNewBlock(chainparams, scriptPubKey);
     CBlock& block = pblocktemplate->block;
 
@@ -145,6 +154,7 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
 
 TestChain100Setup::~TestChain100Setup()
 {
+    SetMockTime(0);
 }
 
 
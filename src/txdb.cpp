@@ -11,9 +11,12 @@
 #include "uint256.h"
 #include "ui_interface.h"
 #include "init.h"
+#include "util.h"
 
 #include <stdint.h>
 
+#include <set>
+
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -24,6 +27,7 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSSUMMARY = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
@@ -32,6 +36,7 @@ static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_INDEX_BUILD = 'I';
 
 namespace {
 
@@ -206,23 +211,135 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+template <typename K>
+static bool EraseKeysWithPrefix(CDBWrapper &db, char prefix) {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(prefix);
+
+    CDBBatch batch(db);
+    size_t nCount = 0;
+    std::pair<char, K> key;
+    while (pcursor->Valid() && pcursor->GetKey(key) && key.first == prefix) {
+        boost::this_thread::interruption_point();
+        batch.Erase(key);
+        pcursor->Next();
+        // write in chunks to keep memory usage low
+        if (++nCount % 10000 == 0) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+    }
+
+    return db.WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+template <typename K, typename V>
+static bool MoveKeysWithPrefix(CDBWrapper &from, CDBWrapper &to, char prefix) {
+    boost::scoped_ptr<CDBIterator> pcursor(from.NewIterator());
+    pcursor->Seek(prefix);
+
+    CDBBatch batchWrite(to);
+    CDBBatch batchErase(from);
+    size_t nCount = 0;
+    std::pair<char, K> key;
+    std::pair<char, K> prev_key;
+    std::pair<char, K> last_key;
+    prev_key.first = prefix;
+    while (pcursor->Valid() && pcursor->GetKey(key) && key.first == prefix) {
+        boost::this_thread::interruption_point();
+        V value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to read index entry", __func__);
+        batchWrite.Write(key, value);
+        batchErase.Erase(key);
+        last_key = key;
+        pcursor->Next();
+        // write in chunks to keep memory usage low
+        if (++nCount % 10000 == 0) {
+            // the copies must be on disk before the entries are erased here, an interrupted
+            // move then simply continues with the entries left on the next start
+            if (!to.WriteBatch(batchWrite, true) || !from.WriteBatch(batchErase))
+                return false;
+            batchWrite.Clear();
+            batchErase.Clear();
+            if (nCount % 1000000 == 0) {
+                LogPrintf("%s: moved %u entries\n", __func__, nCount);
+                from.CompactRange(prev_key, last_key);
+                prev_key = last_key;
+            }
+            if (ShutdownRequested())
+                return false;
         }
     }
-    return WriteBatch(batch);
+
+    if (!to.WriteBatch(batchWrite, true) || !from.WriteBatch(batchErase))
+        return false;
+    if (nCount > 0)
+        from.CompactRange(prev_key, last_key);
+    return true;
+}
+
+bool CBlockTreeDB::MoveLegacyIndexes(CAddressIndexDB *paddressdb, CSpentIndexDB *pspentdb, CTimestampIndexDB *ptimestampdb) {
+    uiInterface.SetProgressBreakAction(StartShutdown);
+    std::string strProgress = _("Moving optional indexes") + "\n" + _("(press q to shutdown and continue later)") + "\n";
+    bool fOk = true;
+    if (fOk && paddressdb) {
+        uiInterface.ShowProgress(strProgress, 0);
+        fOk = MoveKeysWithPrefix<CAddressIndexKey, CAmount>(*this, *paddressdb, DB_ADDRESSINDEX) &&
+              MoveKeysWithPrefix<CAddressUnspentKey, CAddressUnspentValue>(*this, *paddressdb, DB_ADDRESSUNSPENTINDEX) &&
+              MoveKeysWithPrefix<CAddressIndexIteratorKey, CAddressSummaryValue>(*this, *paddressdb, DB_ADDRESSSUMMARY);
+    }
+    if (fOk && pspentdb) {
+        uiInterface.ShowProgress(strProgress, 60);
+        fOk = MoveKeysWithPrefix<CSpentIndexKey, CSpentIndexValue>(*this, *pspentdb, DB_SPENTINDEX);
+    }
+    if (fOk && ptimestampdb) {
+        uiInterface.ShowProgress(strProgress, 90);
+        fOk = MoveKeysWithPrefix<CTimestampIndexKey, int>(*this, *ptimestampdb, DB_TIMESTAMPINDEX);
+    }
+    uiInterface.ShowProgress("", 100);
+    uiInterface.SetProgressBreakAction(std::function<void(void)>());
+    LogPrintf("Moving optional indexes [%s].\n", fOk ? "DONE" : ShutdownRequested() ? "CANCELLED" : "FAILED");
+    return fOk;
+}
+
+bool CBlockTreeDB::EraseLegacyIndexes() {
+    return EraseKeysWithPrefix<CAddressIndexKey>(*this, DB_ADDRESSINDEX) &&
+           EraseKeysWithPrefix<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX) &&
+           EraseKeysWithPrefix<CAddressIndexIteratorKey>(*this, DB_ADDRESSSUMMARY) &&
+           EraseKeysWithPrefix<CTimestampIndexKey>(*this, DB_TIMESTAMPINDEX) &&
+           EraseKeysWithPrefix<CSpentIndexKey>(*this, DB_SPENTINDEX);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+bool CBlockTreeDB::WriteIndexBuildProgress(const CIndexBuildProgress &progress) {
+    return Write(DB_INDEX_BUILD, progress);
+}
+
+bool CBlockTreeDB::ReadIndexBuildProgress(CIndexBuildProgress &progress) {
+    return Read(DB_INDEX_BUILD, progress);
+}
+
+bool CBlockTreeDB::EraseIndexBuildProgress() {
+    return Erase(DB_INDEX_BUILD);
+}
+
+bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
+    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
+}
+
+bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
+    char ch;
+    if (!Read(std::make_pair(DB_FLAG, name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
+}
+
+CAddressIndexDB::CAddressIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "indexes" / "address", nCacheSize, fMemory, fWipe) {
+}
+
+bool CAddressIndexDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
@@ -234,17 +351,31 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+bool CAddressIndexDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           size_t nLimit, CAddressUnspentKey *pCursor) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pCursor && !pCursor->IsNull()) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, *pCursor));
+        pCursor->SetNull();
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
+    size_t nCount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (nLimit > 0 && nCount == nLimit) {
+                // there is more, remember where the next page starts
+                if (pCursor)
+                    *pCursor = key.second;
+                break;
+            }
+            ++nCount;
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
@@ -260,32 +391,114 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+namespace {
+/** Deltas of a single block for one address */
+struct CAddressSummaryDelta {
+    CAddressIndexKey firstKey;
+    CAmount balance;
+    CAmount received;
+    std::set<uint256> setTxHashes;
+
+    CAddressSummaryDelta() : balance(0), received(0) {}
+};
+}
+
+void CAddressIndexDB::UpdateAddressSummaries(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+    std::map<std::pair<unsigned int, uint160>, CAddressSummaryDelta> mapDeltas;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        CAddressSummaryDelta &delta = mapDeltas[make_pair(it->first.type, it->first.hashBytes)];
+        if (delta.setTxHashes.empty())
+            delta.firstKey = it->first;
+        delta.balance += it->second;
+        if (it->second > 0)
+            delta.received += it->second;
+        delta.setTxHashes.insert(it->first.txhash);
+    }
+
+    for (std::map<std::pair<unsigned int, uint160>, CAddressSummaryDelta>::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        const CAddressSummaryDelta &delta = it->second;
+        // the summary already reflects this block if its index entries are (still) there on connect (disconnect)
+        if (Exists(make_pair(DB_ADDRESSINDEX, delta.firstKey)) == !fErase)
+            continue;
+
+        CAddressIndexIteratorKey summaryKey(it->first.first, it->first.second);
+        CAddressSummaryValue summary;
+        if (!Read(make_pair(DB_ADDRESSSUMMARY, summaryKey), summary))
+            summary.SetNull();
+
+        if (!fErase) {
+            summary.balance += delta.balance;
+            summary.received += delta.received;
+            summary.txCount += delta.setTxHashes.size();
+            summary.lastHeight = delta.firstKey.blockHeight;
+        } else {
+            summary.balance -= delta.balance;
+            summary.received -= delta.received;
+            summary.txCount -= std::min<unsigned int>(summary.txCount, delta.setTxHashes.size());
+
+            // the most recent entry below the disconnected height is the new last one
+            boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(summaryKey.type, summaryKey.hashBytes, delta.firstKey.blockHeight)));
+            if (pcursor->Valid())
+                pcursor->Prev();
+            else
+                pcursor->SeekToLast();
+            std::pair<char,CAddressIndexKey> key;
+            if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+                key.second.type == summaryKey.type && key.second.hashBytes == summaryKey.hashBytes) {
+                summary.lastHeight = key.second.blockHeight;
+            } else {
+                summary.lastHeight = 0;
+            }
+        }
+
+        if (summary.txCount == 0)
+            batch.Erase(make_pair(DB_ADDRESSSUMMARY, summaryKey));
+        else
+            batch.Write(make_pair(DB_ADDRESSSUMMARY, summaryKey), summary);
+    }
+}
+
+bool CAddressIndexDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, bool fUpdateSummary) {
     CDBBatch batch(*this);
+    if (fUpdateSummary)
+        UpdateAddressSummaries(batch, vect, false);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+bool CAddressIndexDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, bool fUpdateSummary) {
     CDBBatch batch(*this);
+    if (fUpdateSummary)
+        UpdateAddressSummaries(batch, vect, true);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
+bool CAddressIndexDB::ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary) {
+    if (!Read(make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash)), summary))
+        summary.SetNull();
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end, size_t nLimit, CAddressIndexKey *pCursor) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pCursor && !pCursor->IsNull()) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pCursor));
+        pCursor->SetNull();
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
+    size_t nCount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
@@ -293,6 +506,13 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (nLimit > 0 && nCount == nLimit) {
+                // there is more, remember where the next page starts
+                if (pCursor)
+                    *pCursor = key.second;
+                break;
+            }
+            ++nCount;
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
@@ -308,13 +528,44 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+CSpentIndexDB::CSpentIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "indexes" / "spent", nCacheSize, fMemory, fWipe) {
+}
+
+bool CSpentIndexDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CSpentIndexDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+CTimestampIndexDB::CTimestampIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "indexes" / "timestamp", nCacheSize, fMemory, fWipe) {
+}
+
+bool CTimestampIndexDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+bool CTimestampIndexDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+    std::vector<CTimestampIndexKey> keys;
+    if (!ReadTimestampIndex(high, low, keys))
+        return false;
+    for (std::vector<CTimestampIndexKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+        hashes.push_back(it->blockHash);
+    return true;
+}
+
+bool CTimestampIndexDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<CTimestampIndexKey> &keys) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -324,7 +575,7 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
         boost::this_thread::interruption_point();
         std::pair<char, CTimestampIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
+            keys.push_back(key.second);
             pcursor->Next();
         } else {
             break;
@@ -334,15 +585,51 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
-bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
-    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
-}
+/**
+ * Recompute the NeoScrypt hash of every header and compare it against the hash
+ * stored in its block index record. Entries are striped across all cores and
+ * each core hashes them in batches on the multi-lane engine.
+ */
+static bool CheckBlockIndexPoW(const std::vector<const CBlockIndex*>& vIndex)
+{
+    static const size_t BATCH_SIZE = 64;
+    int nThreads = std::max(GetNumCores(), 1);
+    std::vector<const CBlockIndex*> vFailed(nThreads, NULL);
+
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; i++) {
+        threadGroup.create_thread([&vIndex, &vFailed, i, nThreads] {
+            std::vector<const CBlockIndex*> vBatch;
+            std::vector<CBlockHeader> vHeaders;
+            std::vector<const CBlockHeader*> vpHeaders;
+            for (size_t j = i; j < vIndex.size() && vFailed[i] == NULL; j += BATCH_SIZE * nThreads) {
+                vBatch.clear();
+                for (size_t k = j; k < vIndex.size() && vBatch.size() < BATCH_SIZE; k += nThreads)
+                    vBatch.push_back(vIndex[k]);
+
+                vHeaders.clear();
+                vpHeaders.clear();
+                for (const CBlockIndex* pindex : vBatch)
+                    vHeaders.push_back(pindex->GetBlockHeader());
+                for (const CBlockHeader& header : vHeaders)
+                    vpHeaders.push_back(&header);
+                CacheBlockHeaderHashes(vpHeaders);
+
+                for (size_t k = 0; k < vBatch.size(); k++) {
+                    if (vHeaders[k].GetHash() != vBatch[k]->GetBlockHash()) {
+                        vFailed[i] = vBatch[k];
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    threadGroup.join_all();
 
-bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
-    char ch;
-    if (!Read(std::make_pair(DB_FLAG, name), ch))
-        return false;
-    fValue = ch == '1';
+    for (const CBlockIndex* pindex : vFailed) {
+        if (pindex != NULL)
+            return error("%s: stored block hash does not match header: %s", __func__, pindex->ToString());
+    }
     return true;
 }
 
@@ -352,6 +639,10 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
 
     pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
 
+    bool fCheckPoW = GetBoolArg("-checkblockindexpow", DEFAULT_CHECKBLOCKINDEXPOW);
+    std::vector<const CBlockIndex*> vCheckPoW;
+    std::vector<const CBlockIndex*> vUpgrade;
+
     // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -359,6 +650,12 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
+                // Records without a stored hash are keyed by it anyway, take it
+                // from there instead of running NeoScrypt over the header
+                bool fMissingHash = diskindex.hash.IsNull();
+                if (fMissingHash)
+                    diskindex.hash = key.second;
+
                 // Construct block index object
                 CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
@@ -374,9 +671,16 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
+                // Only compares the stored hash against nBits, the header itself
+                // is rehashed below if -checkblockindexpow is set
                 if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, Params().GetConsensus()))
                     return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
 
+                if (fCheckPoW)
+                    vCheckPoW.push_back(pindexNew);
+                if (fMissingHash)
+                    vUpgrade.push_back(pindexNew);
+
                 pcursor->Next();
             } else {
                 return error("%s: failed to read value", __func__);
@@ -386,6 +690,24 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
         }
     }
 
+    if (fCheckPoW) {
+        int64_t nStart = GetTimeMillis();
+        if (!CheckBlockIndexPoW(vCheckPoW))
+            return false;
+        LogPrintf("%s: verified proof of work of %u block index entries in %dms\n", __func__, vCheckPoW.size(), GetTimeMillis() - nStart);
+    }
+
+    // Rewrite legacy records so that they carry the block hash from now on
+    if (!vUpgrade.empty()) {
+        LogPrintf("%s: upgrading %u block index entries to include the block hash\n", __func__, vUpgrade.size());
+        CDBBatch batch(*this);
+        for (const CBlockIndex* pindex : vUpgrade) {
+            batch.Write(make_pair(DB_BLOCK_INDEX, pindex->GetBlockHash()), CDiskBlockIndex(pindex));
+        }
+        if (!WriteBatch(batch, true))
+            return error("%s: failed to upgrade block index entries", __func__);
+    }
+
     return true;
 }
 
@@ -18,8 +18,11 @@
 
 #include <boost/function.hpp>
 
+class CAddressIndexDB;
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CSpentIndexDB;
+class CTimestampIndexDB;
 class uint256;
 
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
@@ -40,6 +43,12 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to each optional index database cache (MiB)
+static const int64_t nMaxIndexDBCache = 256;
+//! Memory allocated to an optional index database cache that is not enabled on the command line (MiB)
+static const int64_t nMinIndexDBCache = 1;
+//! -checkblockindexpow default
+static const bool DEFAULT_CHECKBLOCKINDEXPOW = false;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -66,6 +75,40 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
+/** Indexes being built in the background and the last block they already include */
+struct CIndexBuildProgress
+{
+    bool fAddressIndex;
+    bool fSpentIndex;
+    bool fTimestampIndex;
+    uint256 hashBestBlock;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(fAddressIndex);
+        READWRITE(fSpentIndex);
+        READWRITE(fTimestampIndex);
+        READWRITE(hashBestBlock);
+    }
+
+    CIndexBuildProgress() {
+        SetNull();
+    }
+
+    void SetNull() {
+        fAddressIndex = false;
+        fSpentIndex = false;
+        fTimestampIndex = false;
+        hashBestBlock.SetNull();
+    }
+
+    bool IsNull() const {
+        return !fAddressIndex && !fSpentIndex && !fTimestampIndex;
+    }
+};
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
@@ -123,21 +166,70 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+    /**
+     * Move index entries kept here by older versions into the given index databases, NULL ones are skipped.
+     * Returns false if interrupted by a shutdown request, calling it again continues with the entries left.
+     */
+    bool MoveLegacyIndexes(CAddressIndexDB *paddressdb, CSpentIndexDB *pspentdb, CTimestampIndexDB *ptimestampdb);
+    /** Erase address, spent and timestamp index entries written before they had databases of their own */
+    bool EraseLegacyIndexes();
+    bool WriteIndexBuildProgress(const CIndexBuildProgress &progress);
+    bool ReadIndexBuildProgress(CIndexBuildProgress &progress);
+    bool EraseIndexBuildProgress();
+    bool WriteFlag(const std::string &name, bool fValue);
+    bool ReadFlag(const std::string &name, bool &fValue);
+    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+};
+
+/** Access to the address index database (indexes/address/) */
+class CAddressIndexDB : public CDBWrapper
+{
+public:
+    CAddressIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CAddressIndexDB(const CAddressIndexDB&);
+    void operator=(const CAddressIndexDB&);
+    /** Apply deltas of a block to per address summaries, unless the address index shows they were applied already */
+    void UpdateAddressSummaries(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
+public:
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 size_t nLimit = 0, CAddressUnspentKey *pCursor = NULL);
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUpdateSummary = false);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUpdateSummary = false);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0,
+                          size_t nLimit = 0, CAddressIndexKey *pCursor = NULL);
+    bool ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
+};
+
+/** Access to the spent index database (indexes/spent/) */
+class CSpentIndexDB : public CDBWrapper
+{
+public:
+    CSpentIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CSpentIndexDB(const CSpentIndexDB&);
+    void operator=(const CSpentIndexDB&);
+public:
+    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+};
+
+/** Access to the timestamp index database (indexes/timestamp/) */
+class CTimestampIndexDB : public CDBWrapper
+{
+public:
+    CTimestampIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CTimestampIndexDB(const CTimestampIndexDB&);
+    void operator=(const CTimestampIndexDB&);
+public:
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
-    bool WriteFlag(const std::string &name, bool fValue);
-    bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<CTimestampIndexKey> &vect);
 };
 
 #endif // BITCOIN_TXDB_H
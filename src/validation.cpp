@@ -15,6 +15,7 @@
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "hash.h"
+#include "indexbuilder.h"
 #include "init.h"
 #include "policy/policy.h"
 #include "pow.h"
@@ -45,6 +46,7 @@
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
@@ -69,10 +71,12 @@ CBlockIndex *pindexBestHeader = NULL;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nParCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
 bool fAddressIndex = false;
+bool fAddressSummaryIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
@@ -189,6 +193,9 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 CCoinsViewDB *pcoinsdbview = NULL;
 CCoinsViewCache *pcoinsTip = NULL;
 CBlockTreeDB *pblocktree = NULL;
+CAddressIndexDB *paddressindexdb = NULL;
+CSpentIndexDB *pspentindexdb = NULL;
+CTimestampIndexDB *ptimestampindexdb = NULL;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -1050,14 +1057,37 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return res;
 }
 
+/** Serialized form of an index key, sorts like the key in the index database */
+template <typename K>
+static std::string GetIndexKeyOrder(const K& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return ss.str();
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
+    // timestamps of recently connected blocks may still be queued for writing
+    std::vector<CTimestampIndexKey> vPending;
+    indexWriteQueue.GetPendingTimestampIndex(high, low, vPending);
+
+    std::vector<CTimestampIndexKey> vKeys;
+    if (!ptimestampindexdb->ReadTimestampIndex(high, low, vKeys))
         return error("Unable to get hashes for timestamps");
 
+    std::map<std::string, uint256> mapHashes;
+    for (std::vector<CTimestampIndexKey>::const_iterator it = vKeys.begin(); it != vKeys.end(); ++it)
+        mapHashes[GetIndexKeyOrder(*it)] = it->blockHash;
+    for (std::vector<CTimestampIndexKey>::const_iterator it = vPending.begin(); it != vPending.end(); ++it)
+        mapHashes[GetIndexKeyOrder(*it)] = it->blockHash;
+
+    for (std::map<std::string, uint256>::const_iterator it = mapHashes.begin(); it != mapHashes.end(); ++it)
+        hashes.push_back(it->second);
+
     return true;
 }
 
@@ -1069,33 +1099,152 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (indexWriteQueue.GetPendingSpentIndex(key, value))
+        return !value.IsNull();
+
+    if (!pspentindexdb->ReadSpentIndex(key, value))
         return false;
 
     return true;
 }
 
+/**
+ * Apply queued updates of an index on top of a page read from its database. The page
+ * starts at cursorIn and ends before the key in cursor, or runs to the end of the
+ * address if cursor is null. Queued entries within the same range complete it, the
+ * resulting page is cut at nLimit entries and cursor set to where the next one starts.
+ */
+template <typename K, typename V>
+static void MergePendingIndexPage(std::vector<std::pair<K, V> > &page, size_t nStart,
+                                  const std::vector<std::pair<bool, std::pair<K, V> > > &vPending,
+                                  const K &cursorIn, size_t nLimit, K *pCursor)
+{
+    std::string strBegin = cursorIn.IsNull() ? std::string() : GetIndexKeyOrder(cursorIn);
+    std::string strEnd = (pCursor && !pCursor->IsNull()) ? GetIndexKeyOrder(*pCursor) : std::string();
+
+    std::map<std::string, std::pair<K, V> > mapPage;
+    for (size_t i = nStart; i < page.size(); i++)
+        mapPage[GetIndexKeyOrder(page[i].first)] = page[i];
+
+    for (typename std::vector<std::pair<bool, std::pair<K, V> > >::const_iterator it = vPending.begin(); it != vPending.end(); ++it) {
+        std::string strKey = GetIndexKeyOrder(it->second.first);
+        if (strKey < strBegin || (!strEnd.empty() && strKey >= strEnd))
+            continue;
+        if (it->first)
+            mapPage.erase(strKey);
+        else
+            mapPage[strKey] = it->second;
+    }
+
+    page.resize(nStart);
+    for (typename std::map<std::string, std::pair<K, V> >::const_iterator it = mapPage.begin(); it != mapPage.end(); ++it) {
+        if (nLimit > 0 && page.size() - nStart == nLimit) {
+            if (pCursor)
+                *pCursor = it->second.first;
+            break;
+        }
+        page.push_back(it->second);
+    }
+}
+
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     size_t nLimit, CAddressIndexKey *pCursor)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    // entries of recently connected or disconnected blocks may still be queued for writing
+    std::vector<std::pair<bool, std::pair<CAddressIndexKey, CAmount> > > vPending;
+    indexWriteQueue.GetPendingAddressIndex(addressHash, type, vPending);
+
+    CAddressIndexKey cursorIn;
+    if (pCursor)
+        cursorIn = *pCursor;
+    CAddressIndexKey cursor = cursorIn;
+    size_t nStart = addressIndex.size();
+
+    if (!paddressindexdb->ReadAddressIndex(addressHash, type, addressIndex, start, end, nLimit, &cursor))
+        return error("unable to get txids for address");
+
+    if (!vPending.empty()) {
+        // same range as the database read
+        std::vector<std::pair<bool, std::pair<CAddressIndexKey, CAmount> > > vInRange;
+        for (size_t i = 0; i < vPending.size(); i++) {
+            int nHeight = vPending[i].second.first.blockHeight;
+            if ((start > 0 && end > 0 && nHeight < start) || (end > 0 && nHeight > end))
+                continue;
+            vInRange.push_back(vPending[i]);
+        }
+        MergePendingIndexPage(addressIndex, nStart, vInRange, cursorIn, nLimit, &cursor);
+    }
+
+    if (pCursor)
+        *pCursor = cursor;
+
+    return true;
+}
+
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    // summaries can't be patched up with queued entries, wait for the ones of this address
+    indexWriteQueue.WaitForAddress(addressHash, type);
+
+    if (fAddressSummaryIndex)
+        return paddressindexdb->ReadAddressSummary(addressHash, type, summary);
+
+    // databases created before summaries were introduced have to scan all deltas
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!paddressindexdb->ReadAddressIndex(addressHash, type, addressIndex))
         return error("unable to get txids for address");
 
+    summary.SetNull();
+    std::set<uint256> setTxHashes;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+        if (it->second > 0)
+            summary.received += it->second;
+        summary.balance += it->second;
+        summary.lastHeight = std::max(summary.lastHeight, it->first.blockHeight);
+        setTxHashes.insert(it->first.txhash);
+    }
+    summary.txCount = setTxHashes.size();
+
     return true;
 }
 
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit, CAddressUnspentKey *pCursor)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    // outputs of recently connected or disconnected blocks may still be queued for writing
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vPending;
+    indexWriteQueue.GetPendingAddressUnspent(addressHash, type, vPending);
+
+    CAddressUnspentKey cursorIn;
+    if (pCursor)
+        cursorIn = *pCursor;
+    CAddressUnspentKey cursor = cursorIn;
+    size_t nStart = unspentOutputs.size();
+
+    if (!paddressindexdb->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, nLimit, &cursor))
         return error("unable to get txids for address");
 
+    if (!vPending.empty()) {
+        std::vector<std::pair<bool, std::pair<CAddressUnspentKey, CAddressUnspentValue> > > vUpdates;
+        for (size_t i = 0; i < vPending.size(); i++)
+            vUpdates.push_back(std::make_pair(vPending[i].second.IsNull(), vPending[i]));
+        MergePendingIndexPage(unspentOutputs, nStart, vUpdates, cursorIn, nLimit, &cursor);
+    }
+
+    if (pCursor)
+        *pCursor = cursor;
+
     return true;
 }
 
@@ -1187,7 +1336,7 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockFromDiskUnchecked(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
@@ -1204,6 +1353,14 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    if (!ReadBlockFromDiskUnchecked(block, pos))
+        return false;
+
     // Check the header
     if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1213,11 +1370,61 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    if (!ReadBlockFromDiskUnchecked(block, pindex->GetBlockPos()))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+
+    // The indexed header already passed CheckProofOfWork when it was accepted, so
+    // rather than rehashing the block read from disk it is enough to make sure its
+    // header is byte for byte the one in the index. The index hash then applies.
+    CBlockHeader header = pindex->GetBlockHeader();
+    if (block.nVersion != header.nVersion || block.hashPrevBlock != header.hashPrevBlock ||
+        block.hashMerkleRoot != header.hashMerkleRoot || block.nTime != header.nTime ||
+        block.nBits != header.nBits || block.nNonce != header.nNonce)
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): header doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+    block.SetCachedHash(pindex->GetBlockHash());
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    block.clear();
+
+    // The block is preceded on disk by the message start and its serialized size
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("ReadRawBlockFromDisk: invalid position %s", pos.ToString());
+    pos.nPos -= MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    // Read block
+    try {
+        CMessageHeader::MessageStartChars blockMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockMessageStart) >> nSize;
+        if (memcmp(blockMessageStart, messageStart, MESSAGE_START_SIZE))
+            return error("%s: block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize < 80 || nSize > MaxBlockSize(true))
+            return error("%s: invalid block size %u at %s", __func__, nSize, pos.ToString());
+        block.resize(nSize);
+        filein.read((char*)&block[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    // Same as ReadBlockFromDisk, the header must be the one in the index
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    ssHeader << pindex->GetBlockHeader();
+    if (memcmp(&ssHeader[0], &block[0], ssHeader.size()))
+        return error("ReadRawBlockFromDisk: header doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+
     return true;
 }
 
@@ -1724,6 +1931,8 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1751,7 +1960,7 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
 }
 
 /** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+bool AbortNode(const std::string& strMessage, const std::string& userMessage)
 {
     strMiscWarning = strMessage;
     LogPrintf("*** %s\n", strMessage);
@@ -1762,14 +1971,12 @@ bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
     return false;
 }
 
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+static bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
 {
     AbortNode(strMessage, userMessage);
     return state.Error(strMessage);
 }
 
-} // anon namespace
-
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1943,12 +2150,13 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
     if (fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
+        CIndexWriteJob job(false);
+        job.fAddressIndex = true;
+        job.fAddressSummaryIndex = fAddressSummaryIndex;
+        job.addressIndex.swap(addressIndex);
+        job.addressUnspentIndex.swap(addressUnspentIndex);
+        if (!indexWriteQueue.Push(job)) {
+            error("DisconnectBlock(): failed to write to index database");
             return DISCONNECT_FAILED;
         }
     }
@@ -1988,6 +2196,75 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CParallelCheck> parallelcheckqueue(4);
+/** Serializes users of parallelcheckqueue, which only supports one master at a time */
+static boost::mutex csParallelCheckQueue;
+
+void ThreadParallelCheck() {
+    RenameThread("sparks-parcheck");
+    parallelcheckqueue.Thread();
+}
+
+bool RunParallelChecks(std::vector<CParallelCheck>& vChecks)
+{
+    if (nParCheckThreads && vChecks.size() > 1) {
+        boost::mutex::scoped_lock lock(csParallelCheckQueue);
+        CCheckQueueControl<CParallelCheck> control(&parallelcheckqueue);
+        control.Add(vChecks);
+        return control.Wait();
+    }
+
+    for (CParallelCheck& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
+}
+
+/** Number of headers per CHeaderPoWCheck, a few rounds of the widest NeoScrypt engine */
+static const unsigned int HEADER_POW_CHECK_BATCH = 32;
+
+/**
+ * Proof-of-work check of a run of block headers.
+ * The run is hashed at once on the multi-lane NeoScrypt engine, which also
+ * leaves the hashes cached for the contextual checks done under cs_main.
+ */
+class CHeaderPoWCheck
+{
+private:
+    std::vector<const CBlockHeader*> vHeaders;
+    const Consensus::Params* pconsensusParams;
+
+public:
+    CHeaderPoWCheck(std::vector<const CBlockHeader*>& vHeadersIn, const Consensus::Params& consensusParams) :
+        pconsensusParams(&consensusParams) { vHeaders.swap(vHeadersIn); }
+
+    bool operator()() {
+        CacheBlockHeaderHashes(vHeaders);
+        for (const CBlockHeader* pheader : vHeaders) {
+            if (!CheckProofOfWork(pheader->GetHash(), pheader->nBits, *pconsensusParams))
+                return false;
+        }
+        return true;
+    }
+};
+
+bool CheckBlockHeadersPoW(const std::vector<CBlockHeader>& headers, CValidationState& state, const Consensus::Params& consensusParams)
+{
+    std::vector<CParallelCheck> vChecks;
+    for (size_t i = 0; i < headers.size(); i += HEADER_POW_CHECK_BATCH) {
+        std::vector<const CBlockHeader*> vBatch;
+        for (size_t j = i; j < headers.size() && j < i + HEADER_POW_CHECK_BATCH; j++)
+            vBatch.push_back(&headers[j]);
+        vChecks.push_back(CParallelCheck(CHeaderPoWCheck(vBatch, consensusParams)));
+    }
+
+    if (!RunParallelChecks(vChecks))
+        return state.DoS(50, error("%s: proof of work failed", __func__),
+                         REJECT_INVALID, "high-hash");
+    return true;
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2388,24 +2665,25 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
+    // index writes are applied in the background, a failed write stops the node right away
+    CIndexWriteJob indexJob(true);
+    indexJob.fAddressIndex = fAddressIndex;
+    indexJob.fAddressSummaryIndex = fAddressSummaryIndex;
+    indexJob.fSpentIndex = fSpentIndex;
+    indexJob.fTimestampIndex = fTimestampIndex;
+    if (!indexJob.IsNull()) {
+        if (fAddressIndex) {
+            indexJob.addressIndex.swap(addressIndex);
+            indexJob.addressUnspentIndex.swap(addressUnspentIndex);
         }
+        if (fSpentIndex)
+            indexJob.spentIndex.swap(spentIndex);
+        if (fTimestampIndex)
+            indexJob.timestampIndex.push_back(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+        if (!indexWriteQueue.Push(indexJob))
+            return state.Error("Failed to write to index database");
     }
 
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2513,6 +2791,10 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         // overwrite one. Still, use a conservative safety factor of 2.
         if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
+        // Write queued index updates first, blocks after the flushed chainstate are reconnected
+        // on restart and write their index entries again.
+        if (!indexWriteQueue.Flush())
+            return AbortNode(state, "Failed to write to index database");
         // Flush the chainstate (which may refer to block index entries).
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
@@ -3508,6 +3790,11 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
+    // Proof of work is context free, check the whole batch in parallel before
+    // taking cs_main. AcceptBlockHeader then finds every hash already cached.
+    if (!CheckBlockHeadersPoW(headers, state, chainparams.GetConsensus()))
+        return false;
+
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -3927,6 +4214,8 @@ bool static LoadBlockIndexDB()
     // Check whether we have an address index
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("addresssummaryindex", fAddressSummaryIndex);
+    fAddressSummaryIndex &= fAddressIndex;
 
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
@@ -3936,6 +4225,26 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
+    // Optional indexes used to be kept in the block tree database, move them to their own databases.
+    // The new databases are only used once all entries are moved, an interrupted move continues
+    // with the entries left on the next start.
+    bool fSeparateIndexes = false;
+    pblocktree->ReadFlag("separateindexes", fSeparateIndexes);
+    if (!fSeparateIndexes) {
+        if (fAddressIndex || fSpentIndex || fTimestampIndex) {
+            LogPrintf("%s: moving optional indexes to databases of their own, this may take a while\n", __func__);
+            if (!pblocktree->MoveLegacyIndexes(fAddressIndex ? paddressindexdb : NULL, fSpentIndex ? pspentindexdb : NULL,
+                                               fTimestampIndex ? ptimestampindexdb : NULL)) {
+                if (ShutdownRequested())
+                    return false;
+                return error("%s: failed to move optional indexes", __func__);
+            }
+            // entries of disabled indexes are erased by the index builder thread
+            pblocktree->WriteFlag("legacyindexes", true);
+        }
+        pblocktree->WriteFlag("separateindexes", true);
+    }
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -4094,6 +4403,9 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    // Balance summaries are kept alongside the address index of new databases
+    fAddressSummaryIndex = fAddressIndex;
+    pblocktree->WriteFlag("addresssummaryindex", fAddressSummaryIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4101,6 +4413,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
 
     fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
     pblocktree->WriteFlag("spentindex", fSpentIndex);
+    pblocktree->WriteFlag("separateindexes", true);
 
     LogPrintf("Initializing databases...\n");
 
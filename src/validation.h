@@ -31,17 +31,22 @@
 
 #include <atomic>
 
+#include <boost/function.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/filesystem/path.hpp>
 
 class CBlockIndex;
+class CAddressIndexDB;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CSpentIndexDB;
+class CTimestampIndexDB;
 class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
@@ -79,6 +84,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads for header proof-of-work and masternode signature checks */
+static const int MAX_PARCHECK_THREADS = 16;
+/** -parcheck default (number of header proof-of-work and masternode signature checking threads) */
+static const int DEFAULT_PARCHECK_THREADS = 2;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -147,7 +156,12 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nParCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fAddressSummaryIndex;
+extern bool fTimestampIndex;
+extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -246,6 +260,8 @@ bool LoadBlockIndex();
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the thread shared by header proof-of-work and masternode signature checks */
+void ThreadParallelCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -295,6 +311,8 @@ CBlockIndex * InsertBlockIndex(uint256 hash);
 void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
+/** Report a fatal internal error and shut the node down, always returns false */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage = "");
 
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
@@ -414,18 +432,45 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing one batch of a check other than script verification,
+ * run by RunParallelChecks on the threads started for -parcheck
+ */
+class CParallelCheck
+{
+private:
+    boost::function<bool()> func;
+
+public:
+    CParallelCheck() {}
+    CParallelCheck(const boost::function<bool()>& funcIn) : func(funcIn) {}
+
+    bool operator()() { return func(); }
+
+    void swap(CParallelCheck& check) { func.swap(check.func); }
+};
+
+/** Run checks, spread over the parallel check threads if there are any; false if one of them failed */
+bool RunParallelChecks(std::vector<CParallelCheck>& vChecks);
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0,
+                     size_t nLimit = 0, CAddressIndexKey *pCursor = NULL);
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit = 0, CAddressUnspentKey *pCursor = NULL);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized block as stored on disk, without deserializing it */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -435,6 +480,8 @@ void ReprocessBlocks(int nBlocks);
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
+/** Check the proof of work of a batch of headers, spread over the parallel check threads */
+bool CheckBlockHeadersPoW(const std::vector<CBlockHeader>& headers, CValidationState& state, const Consensus::Params& consensusParams);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
 /** Context-dependent validity checks */
@@ -473,6 +520,11 @@ extern CCoinsViewCache *pcoinsTip;
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variables that point to the optional index databases */
+extern CAddressIndexDB *paddressindexdb;
+extern CSpentIndexDB *pspentindexdb;
+extern CTimestampIndexDB *ptimestampindexdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -701,7 +701,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    RemoveWalletUTXO(outpoint);
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -709,6 +709,39 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 }
 
 
+void CWallet::AddWalletUTXO(const COutPoint& outpoint, const CAmount& nAmount)
+{
+    setWalletUTXO.insert(outpoint);
+    mapWalletUTXOByAmount[nAmount].insert(outpoint);
+}
+
+void CWallet::RemoveWalletUTXO(const COutPoint& outpoint)
+{
+    if (!setWalletUTXO.erase(outpoint))
+        return;
+
+    std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+    if (mi == mapWallet.end() || outpoint.n >= mi->second.vout.size())
+        return;
+
+    std::map<CAmount, std::set<COutPoint> >::iterator it = mapWalletUTXOByAmount.find(mi->second.vout[outpoint.n].nValue);
+    if (it == mapWalletUTXOByAmount.end())
+        return;
+    it->second.erase(outpoint);
+    if (it->second.empty())
+        mapWalletUTXOByAmount.erase(it);
+}
+
+void CWallet::UpdateWalletUTXO(const CWalletTx& wtx)
+{
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); ++i) {
+        if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
+            AddWalletUTXO(COutPoint(hash, i), wtx.vout[i].nValue);
+        }
+    }
+}
+
 void CWallet::AddToSpends(const uint256& wtxid)
 {
     assert(mapWallet.count(wtxid));
@@ -871,6 +904,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        // ownership of inputs might have changed
+        mapOutpointRoundsCache.clear();
     }
 
     fAnonymizableTallyCached = false;
@@ -888,6 +923,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         wtx.BindWallet(this);
         wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        ResetOutpointPrivateSendRounds(hash);
         BOOST_FOREACH(const CTxIn& txin, wtx.vin) {
             if (mapWallet.count(txin.prevout.hash)) {
                 CWalletTx& prevtx = mapWallet[txin.prevout.hash];
@@ -956,11 +992,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
-            for(int i = 0; i < wtx.vout.size(); ++i) {
-                if (IsMine(wtx.vout[i]) && !IsSpent(hash, i)) {
-                    setWalletUTXO.insert(COutPoint(hash, i));
-                }
-            }
+            ResetOutpointPrivateSendRounds(hash);
         }
 
         bool fUpdated = false;
@@ -988,8 +1020,20 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                 wtx.fFromMe = wtxIn.fFromMe;
                 fUpdated = true;
             }
+            // a tx which is no longer conflicted or abandoned spends its inputs again
+            if (fUpdated)
+            {
+                BOOST_FOREACH(const CTxIn& txin, wtx.vin)
+                {
+                    if (IsSpent(txin.prevout.hash, txin.prevout.n))
+                        RemoveWalletUTXO(txin.prevout);
+                }
+            }
         }
 
+        // outputs of a known tx might have become ours after a rescan
+        UpdateWalletUTXO(wtx);
+
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1112,8 +1156,11 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    // and they might be available again
+                    UpdateWalletUTXO(mapWallet[txin.prevout.hash]);
+                }
             }
         }
     }
@@ -1176,8 +1223,11 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    // and they might be available again
+                    UpdateWalletUTXO(mapWallet[txin.prevout.hash]);
+                }
             }
         }
     }
@@ -1193,6 +1243,9 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
 
+    // mempool and chain state of the transaction changed
+    MarkBalancesDirty();
+
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
@@ -1241,7 +1294,7 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    AssertLockHeld(cs_wallet);
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1251,17 +1304,12 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int>::const_iterator it = mapOutpointRoundsCache.find(outpoint);
+        if (it != mapOutpointRoundsCache.end()) {
+            // found, just return it
+            return it->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1269,35 +1317,38 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
             return -4;
         }
 
+        int& nRoundsRet = mapOutpointRoundsCache[outpoint];
+
         if (CPrivateSend::IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            nRoundsRet = -3;
+            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+            return nRoundsRet;
         }
 
         //make sure the final output is non-denominate
         if (!CPrivateSend::IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            nRoundsRet = -2;
+            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+            return nRoundsRet;
         }
 
         bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
+        BOOST_FOREACH(const CTxOut& out, wtx->vout) {
             fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
         }
 
         // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            nRoundsRet = 0;
+            LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+            return nRoundsRet;
         }
 
+        // nRoundsRet stays valid while inputs are inserted, std::map doesn't invalidate references
         int nShortest = -10; // an initial value, should be no way to get this by calculations
         bool fDenomFound = false;
         // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
+        BOOST_FOREACH(const CTxIn& txinNext, wtx->vin) {
             if (IsMine(txinNext)) {
                 int n = GetRealOutpointPrivateSendRounds(txinNext.prevout, nRounds + 1);
                 // denom found, find the shortest chain or initially assign nShortest with the first found value
@@ -1307,16 +1358,42 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
                 }
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
+        nRoundsRet = fDenomFound
                 ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
                 : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+        LogPrint("privatesend", "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+        return nRoundsRet;
     }
 
     return nRounds - 1;
 }
 
+void CWallet::ResetOutpointPrivateSendRounds(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+
+    // rounds of the outputs spending this tx depend on it, and so on
+    std::vector<uint256> vecToReset(1, hash);
+    bool fRoot = true;
+    while (!vecToReset.empty()) {
+        uint256 hashNow = vecToReset.back();
+        vecToReset.pop_back();
+        TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(hashNow, 0));
+        std::map<COutPoint, int>::iterator itRounds = mapOutpointRoundsCache.lower_bound(COutPoint(hashNow, 0));
+        // outputs which were never computed can't be part of computed chains
+        bool fComputed = itRounds != mapOutpointRoundsCache.end() && itRounds->first.hash == hashNow;
+        while (itRounds != mapOutpointRoundsCache.end() && itRounds->first.hash == hashNow) {
+            mapOutpointRoundsCache.erase(itRounds++);
+        }
+        if (!fComputed && !fRoot) continue;
+        while (iter != mapTxSpends.end() && iter->first.hash == hashNow) {
+            vecToReset.push_back(iter->second);
+            ++iter;
+        }
+        fRoot = false;
+    }
+}
+
 // respect current settings
 int CWallet::GetOutpointPrivateSendRounds(const COutPoint& outpoint) const
 {
@@ -2030,6 +2107,24 @@ bool CWalletTx::InMempool() const
     return false;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fAnonymizedCreditCached = false;
+    fDenomUnconfCreditCached = false;
+    fDenomConfCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalancesDirty();
+}
+
 bool CWalletTx::IsTrusted() const
 {
     // Quick answer in most cases
@@ -2128,20 +2223,60 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+CWalletBalances CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        LOCK(cs_wallet);
+        if (nBalancesCachedGeneration == nBalancesGeneration)
+            return balancesCached;
+    }
+
+    CWalletBalances balances;
+
+    LOCK2(cs_main, cs_wallet);
+    // anything changing after this point bumps the generation again
+    int nGeneration = nBalancesGeneration;
+
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    {
+        const CWalletTx* pcoin = &(*it).second;
+        if (pcoin->IsTrusted()) {
+            balances.nBalance += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool()) {
+            balances.nUnconfirmedBalance += pcoin->GetAvailableCredit();
+            balances.nUnconfirmedWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmatureBalance += pcoin->GetImmatureCredit();
+        balances.nImmatureWatchOnlyBalance += pcoin->GetImmatureWatchOnlyCredit();
+        if (!fLiteMode) {
+            balances.nDenominatedConfirmedBalance += pcoin->GetDenominatedCredit(false);
+            balances.nDenominatedUnconfirmedBalance += pcoin->GetDenominatedCredit(true);
         }
     }
 
-    return nTotal;
+    if (!fLiteMode) {
+        std::set<uint256> setWalletTxesCounted;
+        for (auto& outpoint : setWalletUTXO) {
+
+            if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
+            setWalletTxesCounted.insert(outpoint.hash);
+
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it != mapWallet.end() && it->second.IsTrusted())
+                balances.nAnonymizedBalance += it->second.GetAnonymizedCredit();
+        }
+    }
+
+    balancesCached = balances;
+    nBalancesCachedGeneration = nGeneration;
+
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nBalance;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -2168,25 +2303,7 @@ CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfi
 
 CAmount CWallet::GetAnonymizedBalance() const
 {
-    if(fLiteMode) return 0;
-
-    CAmount nTotal = 0;
-
-    LOCK2(cs_main, cs_wallet);
-
-    std::set<uint256> setWalletTxesCounted;
-    for (auto& outpoint : setWalletUTXO) {
-
-        if (setWalletTxesCounted.find(outpoint.hash) != setWalletTxesCounted.end()) continue;
-        setWalletTxesCounted.insert(outpoint.hash);
-
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash); it != mapWallet.end() && it->first == outpoint.hash; ++it) {
-            if (it->second.IsTrusted())
-                nTotal += it->second.GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymizedBalance;
 }
 
 // Note: calculated including unconfirmed,
@@ -2259,94 +2376,33 @@ CAmount CWallet::GetNeedsToBeAnonymizedBalance(CAmount nMinBalance) const
 
 CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
-    if(fLiteMode) return 0;
-
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    CWalletBalances balances = GetBalances();
+    return unconfirmed ? balances.nDenominatedUnconfirmedBalance : balances.nDenominatedConfirmedBalance;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedBalance;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureBalance;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyBalance;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnlyBalance;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnlyBalance;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2355,56 +2411,99 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+
+        // only unspent outputs of ours can be available, take the ones of the requested type from the index,
+        // all the checks below are still applied to them
+        std::vector<COutPoint> vecOutpoints;
+        if (nCoinType == ONLY_DENOMINATED) {
+            BOOST_FOREACH(CAmount nDenom, CPrivateSend::GetStandardDenominations()) {
+                std::map<CAmount, std::set<COutPoint> >::const_iterator it = mapWalletUTXOByAmount.find(nDenom);
+                if (it != mapWalletUTXOByAmount.end())
+                    vecOutpoints.insert(vecOutpoints.end(), it->second.begin(), it->second.end());
+            }
+            std::sort(vecOutpoints.begin(), vecOutpoints.end());
+        } else if (nCoinType == ONLY_1000) {
+            std::map<CAmount, std::set<COutPoint> >::const_iterator it = mapWalletUTXOByAmount.find(1000*COIN);
+            if (it != mapWalletUTXOByAmount.end())
+                vecOutpoints.assign(it->second.begin(), it->second.end());
+        } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+            std::map<CAmount, std::set<COutPoint> >::const_iterator it = mapWalletUTXOByAmount.upper_bound(CPrivateSend::GetCollateralAmount());
+            std::map<CAmount, std::set<COutPoint> >::const_iterator itEnd = mapWalletUTXOByAmount.upper_bound(CPrivateSend::GetMaxCollateralAmount());
+            for (; it != itEnd; ++it)
+                vecOutpoints.insert(vecOutpoints.end(), it->second.begin(), it->second.end());
+            std::sort(vecOutpoints.begin(), vecOutpoints.end());
+        } else {
+            vecOutpoints.assign(setWalletUTXO.begin(), setWalletUTXO.end());
+        }
+
+        // outpoints are sorted, so outputs of the same tx are next to each other
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.end();
+        bool fTxAvailable = false;
+        int nDepth = 0;
+        BOOST_FOREACH(const COutPoint& outpoint, vecOutpoints)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            if (it == mapWallet.end() || it->first != outpoint.hash) {
+                it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end())
+                    continue;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                const CWalletTx* pcoin = &(*it).second;
+                fTxAvailable = false;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
+
+                if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+                if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                    continue;
+
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
+
+                fTxAvailable = true;
+            }
+            if (!fTxAvailable)
                 continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
+            const uint256& wtxid = it->first;
+            const CWalletTx* pcoin = &(*it).second;
+            unsigned int i = outpoint.n;
+            if (i >= pcoin->vout.size())
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_NONDENOMINATED) {
-                    if (CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_1000) {
-                    found = pcoin->vout[i].nValue == 1000*COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
-                    (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i))))
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                                 (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
+            bool found = false;
+            if(nCoinType == ONLY_DENOMINATED) {
+                found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(nCoinType == ONLY_NONDENOMINATED) {
+                if (CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(nCoinType == ONLY_1000) {
+                found = pcoin->vout[i].nValue == 1000*COIN;
+            } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                found = CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue);
+            } else {
+                found = true;
             }
+            if(!found) continue;
+
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
+                (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i))))
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
         }
     }
 }
@@ -3615,11 +3714,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     {
         LOCK2(cs_main, cs_wallet);
         for (auto& pair : mapWallet) {
-            for(int i = 0; i < pair.second.vout.size(); ++i) {
-                if (IsMine(pair.second.vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
-                }
-            }
+            UpdateWalletUTXO(pair.second);
         }
     }
 
@@ -4148,6 +4243,8 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
 {
     {
         LOCK(cs_wallet);
+        // e.g. an InstantSend lock changes the depth of the transaction
+        MarkBalancesDirty();
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
@@ -4158,6 +4255,12 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
     return false;
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // depth of every transaction has changed
+    MarkBalancesDirty();
+}
+
 void CWallet::GetScriptForMining(boost::shared_ptr<CReserveScript> &script)
 {
     boost::shared_ptr<CReserveKey> rKey(new CReserveKey(this));
@@ -22,6 +22,7 @@
 #include "privatesend.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -110,6 +111,32 @@ struct CompactTallyItem
     }
 };
 
+/** Snapshot of all wallet balances */
+struct CWalletBalances
+{
+    CAmount nBalance;
+    CAmount nUnconfirmedBalance;
+    CAmount nImmatureBalance;
+    CAmount nWatchOnlyBalance;
+    CAmount nUnconfirmedWatchOnlyBalance;
+    CAmount nImmatureWatchOnlyBalance;
+    CAmount nAnonymizedBalance;
+    CAmount nDenominatedConfirmedBalance;
+    CAmount nDenominatedUnconfirmedBalance;
+
+    CWalletBalances() :
+        nBalance(0),
+        nUnconfirmedBalance(0),
+        nImmatureBalance(0),
+        nWatchOnlyBalance(0),
+        nUnconfirmedWatchOnlyBalance(0),
+        nImmatureWatchOnlyBalance(0),
+        nAnonymizedBalance(0),
+        nDenominatedConfirmedBalance(0),
+        nDenominatedUnconfirmedBalance(0)
+    {}
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -406,21 +433,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fAnonymizedCreditCached = false;
-        fDenomUnconfCreditCached = false;
-        fDenomConfCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -627,6 +640,12 @@ private:
     int64_t nLastResend;
     bool fBroadcastTransactions;
 
+    //! incremented whenever something balances depend on might have changed
+    mutable std::atomic<int> nBalancesGeneration;
+    //! generation balancesCached was calculated at
+    mutable int nBalancesCachedGeneration;
+    mutable CWalletBalances balancesCached;
+
     mutable bool fAnonymizableTallyCached;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
     mutable bool fAnonymizableTallyCachedNonDenom;
@@ -643,12 +662,31 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    /**
+     * Same outpoints as in setWalletUTXO grouped by their amounts, so that coins of
+     * a specific type can be found without scanning the whole wallet.
+     * Both may contain outpoints which are not actually available anymore
+     * but never miss any unspent output of ours.
+     */
+    std::map<CAmount, std::set<COutPoint> > mapWalletUTXOByAmount;
+    void AddWalletUTXO(const COutPoint& outpoint, const CAmount& nAmount);
+    void RemoveWalletUTXO(const COutPoint& outpoint);
+    /* Add outputs of this tx which are ours and unspent to wallet UTXOs */
+    void UpdateWalletUTXO(const CWalletTx& wtx);
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * PrivateSend rounds of wallet outpoints, computed on first use and
+     * reset whenever a transaction they might depend on is added.
+     */
+    mutable std::map<COutPoint, int> mapOutpointRoundsCache;
+    /* Reset cached rounds of the outputs of this tx and of all in-wallet txes spending them. */
+    void ResetOutpointPrivateSendRounds(const uint256& hash);
+
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
 
@@ -720,6 +758,8 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        nBalancesGeneration = 0;
+        nBalancesCachedGeneration = -1;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
@@ -861,6 +901,10 @@ public:
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** All balances at once, recalculated only if something they depend on has changed */
+    CWalletBalances GetBalances() const;
+    /** Invalidate cached balances, can be called without holding any locks */
+    void MarkBalancesDirty() const { ++nBalancesGeneration; }
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -949,6 +993,8 @@ public:
 
     bool UpdatedTransaction(const uint256 &hashTx);
 
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+
     void Inventory(const uint256 &hash)
     {
         {